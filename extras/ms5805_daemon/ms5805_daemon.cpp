@@ -0,0 +1,459 @@
+/*
+ * ms5805_daemon : periodic acquisition of many MS5805 on a Linux host.
+ *
+ * A single thread services every sensor. Each one has a periodic timerfd
+ * giving its sampling deadlines and a one-shot timerfd signalling the end of
+ * its conversions, all waited for with epoll, so that no sensor ever blocks
+ * another one in a sleep.
+ *
+ * Samples are printed on stdout as
+ *   sensor,timestamp_ns,temperature,pressure,status
+ * with CLOCK_MONOTONIC timestamps of the start of the temperature conversion.
+ * Per-sensor counters (samples, errors, deadline misses, worst lateness) are
+ * printed on stderr on SIGUSR1 and on exit.
+ *
+ * With -s, samples are also published in a shared-memory ring (see
+ * ms5805_shm_ring.h) that any number of processes can read without touching
+ * the bus.
+ *
+ * Sensors are given as /dev/i2c-N, or /dev/i2c-N:mux_address:channel when
+ * behind a multiplexer, e.g. /dev/i2c-1:0x70:3
+ *
+ * Build from the library root :
+ *   g++ -O2 -std=c++11 -Isrc extras/ms5805_daemon/ms5805_daemon.cpp \
+ *       src/ms5805.cpp src/ms5805_altitude.cpp src/ms5805_bus.cpp \
+ *       src/ms5805_clock.cpp src/ms5805_compensation.cpp \
+ *       src/ms5805_dispatch.cpp src/ms5805_linux_i2c.cpp \
+ *       src/ms5805_sample_cell.cpp src/ms5805_shm_ring.cpp \
+ *       src/ms5805_stage.cpp -lrt -o ms5805_daemon
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ms5805.h"
+#include "ms5805_compensation.h"
+#include "ms5805_linux_i2c.h"
+#include "ms5805_shm_ring.h"
+
+#define MAX_SENSORS 64
+#define MAX_EVENTS 16
+#define DEFAULT_RING_CAPACITY 4096
+#define MAX_RING_CAPACITY (1UL << 24)
+
+// Tags of the epoll events, combined with the sensor index
+#define EVENT_PERIOD 0
+#define EVENT_CONVERSION 1
+#define EVENT_SIGNAL 2
+
+enum sensor_state {
+  sensor_state_idle,
+  sensor_state_temperature,
+  sensor_state_pressure
+};
+
+struct sensor {
+  const char *name;
+  ms5805_linux_i2c_bus bus;
+  ms5805 device;
+  uint16_t coeff[MS5805_COEFFICIENT_COUNT];
+  int period_fd;
+  int conversion_fd;
+  enum sensor_state state;
+  uint64_t deadline_ns;
+  uint64_t timestamp_ns;
+  uint32_t adc_temperature;
+  uint64_t samples;
+  uint64_t errors;
+  uint64_t deadline_misses;
+  uint64_t max_lateness_ns;
+};
+
+static struct sensor sensors[MAX_SENSORS];
+static uint32_t sensor_count = 0;
+static uint64_t period_ns = 100000000;
+static ms5805_shm_ring_writer ring;
+static bool ring_enabled = false;
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: ms5805_daemon [-r rate_hz] [-o osr] [-s shm_name "
+          "[-n capacity]] adapter[:mux:channel]...\n");
+  exit(2);
+}
+
+/**
+* \brief Parse an unsigned number, up to a terminator.
+*
+* \param[in] char* : Text, starting with a digit
+* \param[in] int : Base, 0 to also accept hexadecimal with 0x
+* \param[in] char : Character expected after the number
+* \param[in] unsigned long : Largest value accepted
+* \param[out] unsigned long* : Value
+*
+* \return const char* : Terminator in the text, NULL if the number is invalid
+* or out of range
+*/
+static const char *parse_unsigned(const char *text, int base, char terminator,
+                                  unsigned long max, unsigned long *value) {
+  char *end;
+
+  // strtoul would take leading spaces and negate a minus sign
+  if (!isdigit((unsigned char)*text))
+    return NULL;
+  errno = 0;
+  *value = strtoul(text, &end, base);
+  if (errno != 0 || *end != terminator || *value > max)
+    return NULL;
+
+  return end;
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void to_timespec(uint64_t ns, struct timespec *ts) {
+  ts->tv_sec = ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+}
+
+static int add_event(int epoll_fd, int fd, uint32_t tag, uint32_t index) {
+  struct epoll_event event;
+
+  event.events = EPOLLIN;
+  event.data.u64 = ((uint64_t)index << 8) | tag;
+
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/**
+* \brief Open the adapter of a sensor and read its PROM.
+*
+* \param[in] sensor* : Sensor, name set
+* \param[in] ms5805_resolution_osr : Resolution of the conversions
+*
+* \return bool : false if the sensor cannot be reached
+*/
+static bool open_sensor(struct sensor *s, enum ms5805_resolution_osr osr) {
+  char path[64];
+  unsigned long mux_address, channel;
+  const char *separator;
+  enum ms5805_status status;
+
+  separator = strchr(s->name, ':');
+  if (separator) {
+    snprintf(path, sizeof(path), "%.*s", (int)(separator - s->name), s->name);
+    separator = parse_unsigned(separator + 1, 0, ':', 0x7F, &mux_address);
+    if (!separator || !parse_unsigned(separator + 1, 10, '\0', 7, &channel) ||
+        !s->bus.set_mux(mux_address, channel)) {
+      fprintf(stderr, "%s: invalid multiplexer\n", s->name);
+      usage();
+    }
+  } else {
+    snprintf(path, sizeof(path), "%s", s->name);
+  }
+
+  if (!s->bus.open(path)) {
+    perror(path);
+    return false;
+  }
+  s->device.set_bus(&s->bus);
+  s->device.set_resolution(osr);
+
+  status = s->device.read_coefficients(s->coeff);
+  if (status != ms5805_status_ok) {
+    fprintf(stderr, "%s: cannot read PROM (status %d)\n", s->name, status);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+* \brief Arm the timers of a sensor. Sensors are spread over the period to
+* avoid bursts on shared adapters.
+*
+* \param[in] sensor* : Sensor
+* \param[in] uint32_t : Index of the sensor
+* \param[in] uint64_t : Start time of the acquisition
+*
+* \return bool : false if the timers cannot be created
+*/
+static bool arm_sensor(struct sensor *s, uint32_t index, uint64_t start_ns) {
+  struct itimerspec spec;
+
+  s->period_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  s->conversion_fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (s->period_fd < 0 || s->conversion_fd < 0)
+    return false;
+
+  s->deadline_ns = start_ns + period_ns * index / sensor_count;
+  to_timespec(s->deadline_ns, &spec.it_value);
+  to_timespec(period_ns, &spec.it_interval);
+
+  return timerfd_settime(s->period_fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0;
+}
+
+static void wait_conversion(struct sensor *s) {
+  struct itimerspec spec;
+
+  memset(&spec, 0, sizeof(spec));
+  to_timespec((uint64_t)s->device.get_conversion_time() * 1000000,
+              &spec.it_value);
+  timerfd_settime(s->conversion_fd, 0, &spec, NULL);
+}
+
+static void publish(struct sensor *s, int32_t temperature, int32_t pressure,
+                    enum ms5805_status status) {
+  struct ms5805_ring_record record;
+
+  if (status == ms5805_status_ok)
+    printf("%u,%llu,%.2f,%.2f,%d\n", (unsigned int)(s - sensors),
+           (unsigned long long)s->timestamp_ns, temperature / 100.0,
+           pressure / 100.0, status);
+  else
+    printf("%u,%llu,,,%d\n", (unsigned int)(s - sensors),
+           (unsigned long long)s->timestamp_ns, status);
+
+  if (ring_enabled) {
+    record.timestamp_ns = s->timestamp_ns;
+    record.sensor = s - sensors;
+    record.temperature = temperature;
+    record.pressure = pressure;
+    record.status = status;
+    ring.publish(&record);
+  }
+}
+
+static void fail(struct sensor *s, enum ms5805_status status) {
+  s->errors++;
+  s->state = sensor_state_idle;
+  publish(s, 0, 0, status);
+}
+
+/**
+* \brief Sampling deadline of a sensor : start the temperature conversion.
+*/
+static void on_period(struct sensor *s) {
+  enum ms5805_status status;
+  uint64_t expirations;
+  uint64_t now = monotonic_ns();
+
+  if (read(s->period_fd, &expirations, sizeof(expirations)) !=
+      sizeof(expirations))
+    return;
+
+  // Deadlines elapsed without being serviced, or while still converting
+  s->deadline_misses += expirations - 1;
+  s->deadline_ns += period_ns * (expirations - 1);
+  if (now - s->deadline_ns > s->max_lateness_ns)
+    s->max_lateness_ns = now - s->deadline_ns;
+  s->deadline_ns += period_ns;
+
+  if (s->state != sensor_state_idle) {
+    s->deadline_misses++;
+    return;
+  }
+
+  s->timestamp_ns = now;
+  status = s->device.start_conversion(ms5805_measurement_temperature);
+  if (status != ms5805_status_ok) {
+    fail(s, status);
+    return;
+  }
+  s->state = sensor_state_temperature;
+  wait_conversion(s);
+}
+
+/**
+* \brief End of a conversion of a sensor : read it, then start the pressure
+* conversion or publish the sample.
+*/
+static void on_conversion(struct sensor *s) {
+  enum ms5805_status status;
+  uint64_t expirations;
+  uint32_t adc_pressure;
+  int32_t temperature, pressure;
+
+  if (read(s->conversion_fd, &expirations, sizeof(expirations)) !=
+      sizeof(expirations))
+    return;
+
+  if (s->state == sensor_state_temperature) {
+    status = s->device.read_adc(&s->adc_temperature);
+    if (status == ms5805_status_ok)
+      status = s->device.start_conversion(ms5805_measurement_pressure);
+    if (status != ms5805_status_ok) {
+      fail(s, status);
+      return;
+    }
+    s->state = sensor_state_pressure;
+    wait_conversion(s);
+  } else if (s->state == sensor_state_pressure) {
+    status = s->device.read_adc(&adc_pressure);
+    if (status == ms5805_status_ok &&
+        (s->adc_temperature == 0 || adc_pressure == 0))
+      status = ms5805_status_i2c_transfer_error;
+    if (status != ms5805_status_ok) {
+      fail(s, status);
+      return;
+    }
+    ms5805_compensate(s->coeff, s->adc_temperature, adc_pressure,
+                      &temperature, &pressure);
+    s->samples++;
+    s->state = sensor_state_idle;
+    publish(s, temperature, pressure, status);
+  }
+}
+
+static void print_statistics(void) {
+  uint32_t i;
+
+  fprintf(stderr, "sensor,samples,errors,deadline_misses,max_lateness_us\n");
+  for (i = 0; i < sensor_count; i++)
+    fprintf(stderr, "%s,%llu,%llu,%llu,%llu\n", sensors[i].name,
+            (unsigned long long)sensors[i].samples,
+            (unsigned long long)sensors[i].errors,
+            (unsigned long long)sensors[i].deadline_misses,
+            (unsigned long long)sensors[i].max_lateness_ns / 1000);
+}
+
+int main(int argc, char **argv) {
+  enum ms5805_resolution_osr osr = ms5805_resolution_osr_4096;
+  struct epoll_event events[MAX_EVENTS];
+  struct signalfd_siginfo info;
+  sigset_t signals;
+  const char *ring_name = NULL;
+  uint32_t ring_capacity = DEFAULT_RING_CAPACITY;
+  unsigned long capacity;
+  char *end;
+  double rate;
+  int epoll_fd, signal_fd;
+  int count, i, opt;
+  bool running = true;
+  uint64_t start_ns;
+  uint32_t index;
+
+  while ((opt = getopt(argc, argv, "r:o:s:n:")) != -1) {
+    switch (opt) {
+    case 'r':
+      rate = strtod(optarg, &end);
+      // The timerfd is disarmed by a period of 0
+      if (end == optarg || *end != '\0' || !(rate > 0) || 1e9 / rate < 1 ||
+          1e9 / rate > 1e18)
+        usage();
+      period_ns = (uint64_t)(1e9 / rate);
+      break;
+    case 'o':
+      for (i = ms5805_resolution_osr_256; i <= ms5805_resolution_osr_8192; i++)
+        if (256 << i == atoi(optarg))
+          break;
+      if (i > ms5805_resolution_osr_8192)
+        usage();
+      osr = (enum ms5805_resolution_osr)i;
+      break;
+    case 's':
+      ring_name = optarg;
+      break;
+    case 'n':
+      if (!parse_unsigned(optarg, 10, '\0', MAX_RING_CAPACITY, &capacity) ||
+          capacity < 1)
+        usage();
+      ring_capacity = (uint32_t)capacity;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind >= argc || argc - optind > MAX_SENSORS)
+    usage();
+
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+  signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (signal_fd < 0 || epoll_fd < 0 ||
+      add_event(epoll_fd, signal_fd, EVENT_SIGNAL, 0) != 0) {
+    perror("ms5805_daemon");
+    return 1;
+  }
+
+  sensor_count = argc - optind;
+  for (index = 0; index < sensor_count; index++) {
+    sensors[index].name = argv[optind + index];
+    if (!open_sensor(&sensors[index], osr))
+      return 1;
+  }
+  if (ring_name) {
+    if (!ring.create(ring_name, ring_capacity)) {
+      perror(ring_name);
+      return 1;
+    }
+    ring_enabled = true;
+  }
+  if (2 * (uint64_t)sensors[0].device.get_conversion_time() * 1000000 >=
+      period_ns)
+    fprintf(stderr, "warning: period shorter than the conversions\n");
+
+  start_ns = monotonic_ns() + period_ns;
+  for (index = 0; index < sensor_count; index++) {
+    if (!arm_sensor(&sensors[index], index, start_ns) ||
+        add_event(epoll_fd, sensors[index].period_fd, EVENT_PERIOD, index) ||
+        add_event(epoll_fd, sensors[index].conversion_fd, EVENT_CONVERSION,
+                  index)) {
+      perror("ms5805_daemon");
+      return 1;
+    }
+  }
+
+  while (running) {
+    count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0) {
+      perror("epoll_wait");
+      return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+      index = events[i].data.u64 >> 8;
+      switch (events[i].data.u64 & 0xFF) {
+      case EVENT_PERIOD:
+        on_period(&sensors[index]);
+        break;
+      case EVENT_CONVERSION:
+        on_conversion(&sensors[index]);
+        break;
+      case EVENT_SIGNAL:
+        if (read(signal_fd, &info, sizeof(info)) != sizeof(info))
+          break;
+        if (info.ssi_signo == SIGUSR1)
+          print_statistics();
+        else
+          running = false;
+        break;
+      }
+    }
+    fflush(stdout);
+  }
+
+  print_statistics();
+
+  return 0;
+}
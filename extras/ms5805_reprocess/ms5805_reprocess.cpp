@@ -0,0 +1,484 @@
+/*
+ * ms5805_reprocess : compensate large raw MS5805 logs on a Linux host.
+ *
+ * Reads raw captures (ms5805_capture, "M5R") and compressed logs
+ * (ms5805_codec, "M5Z"), splits them into chunks at block boundaries and
+ * compensates the chunks in parallel with the same math as the driver.
+ * Every input <file> produces <file>.csv, or <file>.m5c in columnar binary :
+ *
+ *   'M' '5' 'C' version | 4 reserved bytes | sample count (8)
+ *   | timestamps (uint32 x count) | temperatures in 0.01 Celsius Degree
+ *   (int32 x count) | pressures in 0.01 mbar (int32 x count)
+ *
+ * Binary values are in host byte order.
+ *
+ * Build from the library root :
+ *   g++ -O2 -std=c++11 -pthread -Isrc \
+ *       extras/ms5805_reprocess/ms5805_reprocess.cpp \
+ *       src/ms5805_capture.cpp src/ms5805_codec.cpp \
+ *       src/ms5805_compensation.cpp src/ms5805_writer.cpp -o ms5805_reprocess
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ms5805_capture.h"
+#include "ms5805_codec.h"
+#include "ms5805_compensation.h"
+
+// Target number of samples per chunk
+#define CHUNK_SAMPLES 65536
+// Maximum number of CSV chunks formatted ahead of the writer, per thread
+#define CSV_WINDOW_PER_THREAD 4
+// Largest number of threads accepted by -j
+#define MAX_THREADS 1024
+
+#define COLUMNAR_HEADER_SIZE 16
+
+enum log_format { log_format_capture, log_format_codec };
+
+enum output_format { output_format_csv, output_format_columnar };
+
+struct input_file {
+  const char *path;
+  const uint8_t *data;
+  size_t length;
+  enum log_format format;
+  bool raw;
+  uint16_t coeff[MS5805_CODEC_PROM_COUNT];
+  uint64_t samples;
+  int output_fd;
+  uint8_t *output;
+  size_t output_length;
+};
+
+struct chunk {
+  struct input_file *file;
+  size_t offset;
+  uint32_t timestamp; // Time preceding the chunk, for raw captures
+  uint64_t first;
+  uint32_t count;
+  std::string text;
+  bool done;
+  bool failed;
+};
+
+static std::vector<struct input_file> files;
+static std::vector<struct chunk> chunks;
+static enum output_format format = output_format_csv;
+
+static std::atomic<size_t> next_chunk(0);
+static std::mutex chunk_mutex;
+static std::condition_variable chunk_done;
+static std::condition_variable chunk_written;
+static size_t written_chunks = 0;
+static size_t csv_window;
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: ms5805_reprocess [-j threads] [-f csv|bin] file...\n");
+  exit(2);
+}
+
+/**
+* \brief Map an input log and identify its format.
+*
+* \param[in] input_file* : File to open, path set
+*
+* \return bool : false if the file cannot be read or is not a MS5805 log
+*/
+static bool open_input(struct input_file *file) {
+  struct stat st;
+  struct ms5805_capture_header capture_header;
+  struct ms5805_codec_header codec_header;
+  int fd;
+
+  fd = open(file->path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(file->path);
+    return false;
+  }
+  file->length = st.st_size;
+  file->data = (const uint8_t *)mmap(NULL, file->length ? file->length : 1,
+                                     PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file->data == MAP_FAILED) {
+    perror(file->path);
+    return false;
+  }
+  madvise((void *)file->data, file->length, MADV_SEQUENTIAL);
+
+  ms5805_capture_decoder capture(file->data, file->length);
+  ms5805_codec_decoder codec(file->data, file->length);
+  if (capture.read_header(&capture_header)) {
+    file->format = log_format_capture;
+    file->raw = true;
+    memcpy(file->coeff, capture_header.coeff, sizeof(file->coeff));
+  } else if (codec.read_header(&codec_header)) {
+    file->format = log_format_codec;
+    file->raw = codec_header.kind == MS5805_CODEC_KIND_RAW;
+    memcpy(file->coeff, codec_header.coeff, sizeof(file->coeff));
+  } else {
+    fprintf(stderr, "%s: not a MS5805 log\n", file->path);
+    return false;
+  }
+
+  if (file->raw && ms5805_prom_crc(file->coeff) != file->coeff[0] >> 12)
+    fprintf(stderr, "%s: warning, CRC error on the PROM coefficients\n",
+            file->path);
+
+  return true;
+}
+
+static void add_chunk(struct input_file *file, size_t offset,
+                      uint32_t timestamp, uint32_t count) {
+  struct chunk c;
+
+  c.file = file;
+  c.offset = offset;
+  c.timestamp = timestamp;
+  c.first = file->samples;
+  c.count = count;
+  c.done = false;
+  c.failed = false;
+  chunks.push_back(c);
+  file->samples += count;
+}
+
+/**
+* \brief Split a log into chunks. Compressed logs are split at keyframe blocks
+* without decoding them, raw captures need a scan of the record sizes.
+*
+* \param[in] input_file* : File to split
+*
+* \return bool : false if the log is corrupted
+*/
+static bool split_input(struct input_file *file) {
+  struct ms5805_capture_header capture_header;
+  struct ms5805_capture_record record;
+  struct ms5805_codec_header codec_header;
+  size_t offset;
+  uint32_t timestamp;
+  uint32_t count = 0;
+  uint32_t block_count;
+
+  if (file->format == log_format_codec) {
+    ms5805_codec_decoder decoder(file->data, file->length);
+    decoder.read_header(&codec_header);
+    offset = decoder.position();
+    while (decoder.skip_block(&block_count)) {
+      count += block_count;
+      if (count >= CHUNK_SAMPLES) {
+        add_chunk(file, offset, 0, count);
+        offset = decoder.position();
+        count = 0;
+      }
+    }
+    if (count)
+      add_chunk(file, offset, 0, count);
+    if (decoder.position() != file->length) {
+      fprintf(stderr, "%s: corrupted block at offset %zu\n", file->path,
+              decoder.position());
+      return false;
+    }
+  } else {
+    ms5805_capture_decoder decoder(file->data, file->length);
+    decoder.read_header(&capture_header);
+    offset = decoder.position();
+    timestamp = decoder.time();
+    while (decoder.read_record(&record)) {
+      if (++count == CHUNK_SAMPLES) {
+        add_chunk(file, offset, timestamp, count);
+        offset = decoder.position();
+        timestamp = decoder.time();
+        count = 0;
+      }
+    }
+    if (count)
+      add_chunk(file, offset, timestamp, count);
+    if (decoder.position() != file->length)
+      fprintf(stderr, "%s: warning, truncated last record ignored\n",
+              file->path);
+  }
+
+  return true;
+}
+
+/**
+* \brief Create the output of a log. Columnar outputs are mapped so that
+* every thread writes its chunks in place.
+*
+* \param[in] input_file* : File split into chunks
+*
+* \return bool : false if the output cannot be created
+*/
+static bool open_output(struct input_file *file) {
+  std::string path(file->path);
+  uint64_t count = file->samples;
+
+  path += format == output_format_csv ? ".csv" : ".m5c";
+  file->output_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file->output_fd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  if (format == output_format_csv) {
+    static const char header[] = "timestamp,temperature,pressure\n";
+    return write(file->output_fd, header, sizeof(header) - 1) ==
+           sizeof(header) - 1;
+  }
+
+  file->output_length = COLUMNAR_HEADER_SIZE + count * 12;
+  if (ftruncate(file->output_fd, file->output_length) != 0) {
+    perror(path.c_str());
+    return false;
+  }
+  file->output = (uint8_t *)mmap(NULL, file->output_length,
+                                 PROT_READ | PROT_WRITE, MAP_SHARED,
+                                 file->output_fd, 0);
+  if (file->output == MAP_FAILED) {
+    perror(path.c_str());
+    return false;
+  }
+  memset(file->output, 0, COLUMNAR_HEADER_SIZE);
+  memcpy(file->output, "M5C", 3);
+  file->output[3] = 1;
+  memcpy(file->output + 8, &count, sizeof(count));
+
+  return true;
+}
+
+/**
+* \brief Append a value in hundredths as a decimal number, avoiding the cost
+* of printf on large logs.
+*/
+static void append_fixed(std::string &text, int32_t value) {
+  char digits[16];
+  uint32_t magnitude;
+  int n = 0;
+
+  if (value < 0)
+    text += '-';
+  magnitude = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+  do {
+    digits[n++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude || n < 3);
+  while (n > 2)
+    text += digits[--n];
+  text += '.';
+  text += digits[1];
+  text += digits[0];
+}
+
+static void append_unsigned(std::string &text, uint32_t value) {
+  char digits[10];
+  int n = 0;
+
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (n)
+    text += digits[--n];
+}
+
+/**
+* \brief Decode and compensate a chunk into the output of its file.
+*
+* \param[in] chunk* : Chunk to process
+*
+* \return bool : false on corrupted data
+*/
+static bool process_chunk(struct chunk *c) {
+  struct input_file *file = c->file;
+  struct ms5805_capture_header capture_header;
+  struct ms5805_capture_record record;
+  struct ms5805_codec_header codec_header;
+  struct ms5805_codec_sample sample;
+  uint32_t *timestamps = NULL;
+  int32_t *temperatures = NULL;
+  int32_t *pressures = NULL;
+  int32_t temperature, pressure;
+  uint32_t i;
+
+  ms5805_capture_decoder capture(file->data, file->length);
+  ms5805_codec_decoder codec(file->data, file->length);
+  if (file->format == log_format_capture) {
+    capture.read_header(&capture_header);
+    capture.seek(c->offset, c->timestamp);
+  } else {
+    codec.read_header(&codec_header);
+    if (!codec.seek(c->offset))
+      return false;
+  }
+
+  if (format == output_format_columnar) {
+    timestamps = (uint32_t *)(file->output + COLUMNAR_HEADER_SIZE) + c->first;
+    temperatures = (int32_t *)(file->output + COLUMNAR_HEADER_SIZE) +
+                   file->samples + c->first;
+    pressures = (int32_t *)(file->output + COLUMNAR_HEADER_SIZE) +
+                2 * file->samples + c->first;
+  } else {
+    c->text.reserve((size_t)c->count * 28);
+  }
+
+  for (i = 0; i < c->count; i++) {
+    if (file->format == log_format_capture) {
+      if (!capture.read_record(&record))
+        return false;
+      sample.timestamp = record.timestamp_ms;
+      sample.temperature = record.adc_temperature;
+      sample.pressure = record.adc_pressure;
+    } else if (!codec.read_sample(&sample)) {
+      return false;
+    }
+
+    if (file->raw)
+      ms5805_compensate(file->coeff, sample.temperature, sample.pressure,
+                        &temperature, &pressure);
+    else {
+      temperature = sample.temperature;
+      pressure = sample.pressure;
+    }
+
+    if (format == output_format_columnar) {
+      timestamps[i] = sample.timestamp;
+      temperatures[i] = temperature;
+      pressures[i] = pressure;
+    } else {
+      append_unsigned(c->text, sample.timestamp);
+      c->text += ',';
+      append_fixed(c->text, temperature);
+      c->text += ',';
+      append_fixed(c->text, pressure);
+      c->text += '\n';
+    }
+  }
+
+  return true;
+}
+
+static void worker(void) {
+  size_t index;
+
+  for (;;) {
+    if (format == output_format_csv) {
+      // Bound the memory held by formatted chunks waiting to be written
+      std::unique_lock<std::mutex> lock(chunk_mutex);
+      index = next_chunk++;
+      chunk_written.wait(
+          lock, [index] { return index < written_chunks + csv_window; });
+    } else {
+      index = next_chunk++;
+    }
+    if (index >= chunks.size())
+      return;
+
+    bool ok = process_chunk(&chunks[index]);
+
+    std::lock_guard<std::mutex> lock(chunk_mutex);
+    chunks[index].failed = !ok;
+    chunks[index].done = true;
+    chunk_done.notify_all();
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::thread> threads;
+  unsigned int thread_count = std::thread::hardware_concurrency();
+  bool failed = false;
+  char *end;
+  long value;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:f:")) != -1) {
+    switch (opt) {
+    case 'j':
+      errno = 0;
+      value = strtol(optarg, &end, 10);
+      if (errno != 0 || end == optarg || *end != '\0' || value < 1 ||
+          value > MAX_THREADS)
+        usage();
+      thread_count = (unsigned int)value;
+      break;
+    case 'f':
+      if (strcmp(optarg, "csv") == 0)
+        format = output_format_csv;
+      else if (strcmp(optarg, "bin") == 0)
+        format = output_format_columnar;
+      else
+        usage();
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind >= argc)
+    usage();
+  if (thread_count == 0)
+    thread_count = 1;
+  csv_window = thread_count * CSV_WINDOW_PER_THREAD;
+
+  files.resize(argc - optind);
+  for (i = 0; i < files.size(); i++) {
+    memset(&files[i], 0, sizeof(files[i]));
+    files[i].path = argv[optind + i];
+    if (!open_input(&files[i]) || !split_input(&files[i]) ||
+        !open_output(&files[i]))
+      return 1;
+  }
+
+  for (i = 0; i < thread_count; i++)
+    threads.push_back(std::thread(worker));
+
+  // CSV chunks are written in order as soon as they are ready
+  for (i = 0; i < chunks.size(); i++) {
+    struct chunk *c = &chunks[i];
+    {
+      std::unique_lock<std::mutex> lock(chunk_mutex);
+      chunk_done.wait(lock, [c] { return c->done; });
+    }
+    if (c->failed) {
+      fprintf(stderr, "%s: corrupted data at offset %zu\n", c->file->path,
+              c->offset);
+      failed = true;
+    } else if (format == output_format_csv &&
+               write(c->file->output_fd, c->text.data(), c->text.size()) !=
+                   (ssize_t)c->text.size()) {
+      perror(c->file->path);
+      failed = true;
+    }
+    std::string().swap(c->text);
+    {
+      std::lock_guard<std::mutex> lock(chunk_mutex);
+      written_chunks++;
+    }
+    chunk_written.notify_all();
+  }
+
+  for (i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  for (i = 0; i < files.size(); i++) {
+    if (files[i].output)
+      munmap(files[i].output, files[i].output_length);
+    close(files[i].output_fd);
+    munmap((void *)files[i].data, files[i].length ? files[i].length : 1);
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * ms5805_ring_reader : print the samples published by ms5805_daemon -s.
+ *
+ * Maps the shared-memory ring read-only and prints every new record as
+ *   sensor,timestamp_ns,temperature,pressure,status
+ * or only the latest one with -l. Any number of readers can run at once, and
+ * they follow the ring again when the daemon restarts.
+ *
+ * Build from the library root :
+ *   g++ -O2 -std=c++11 -Isrc extras/ms5805_ring_reader/ms5805_ring_reader.cpp \
+ *       src/ms5805_shm_ring.cpp -lrt -o ms5805_ring_reader
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ms5805_shm_ring.h"
+
+// Polling interval when no record is available
+#define POLL_INTERVAL_US 1000
+
+// Idle polls between checks for a ring replaced by a restarted daemon
+#define REPLACED_CHECK_POLLS 1000
+
+static void print_record(const struct ms5805_ring_record *record) {
+  printf("%u,%llu,%.2f,%.2f,%d\n", record->sensor,
+         (unsigned long long)record->timestamp_ns, record->temperature / 100.0,
+         record->pressure / 100.0, record->status);
+}
+
+int main(int argc, char **argv) {
+  ms5805_shm_ring_reader reader;
+  struct ms5805_ring_record record;
+  enum ms5805_ring_result result;
+  uint64_t cursor = 0;
+  uint64_t previous;
+  uint64_t lost = 0;
+  unsigned idle = 0;
+  bool latest = argc == 3 && strcmp(argv[1], "-l") == 0;
+
+  if (argc != 2 && !latest) {
+    fprintf(stderr, "usage: ms5805_ring_reader [-l] shm_name\n");
+    return 2;
+  }
+  if (!reader.open(argv[argc - 1])) {
+    perror(argv[argc - 1]);
+    return 1;
+  }
+
+  if (latest) {
+    if (reader.read_latest(&record) != ms5805_ring_ok)
+      return 1;
+    print_record(&record);
+    return 0;
+  }
+
+  for (;;) {
+    previous = cursor;
+    result = reader.read_next(&cursor, &record);
+    if (result == ms5805_ring_ok) {
+      print_record(&record);
+    } else if (result == ms5805_ring_overrun) {
+      // The cursor jumped over the overwritten records
+      lost += cursor - previous;
+      fprintf(stderr, "overrun, %llu records skipped, %llu lost so far\n",
+              (unsigned long long)(cursor - previous),
+              (unsigned long long)lost);
+    } else {
+      fflush(stdout);
+      usleep(POLL_INTERVAL_US);
+      if (++idle < REPLACED_CHECK_POLLS)
+        continue;
+      idle = 0;
+      if (reader.is_replaced()) {
+        reader.close();
+        while (!reader.open(argv[argc - 1]))
+          usleep(POLL_INTERVAL_US);
+        cursor = 0;
+      }
+      continue;
+    }
+    idle = 0;
+  }
+}
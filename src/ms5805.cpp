@@ -1,12 +1,18 @@
-#include <Wire.h>
+#include <string.h>
+
+#if defined(__AVR__)
+#include <util/atomic.h>
+#endif
 
 #include "ms5805.h"
+#include "ms5805_bus.h"
+#include "ms5805_compensation.h"
+#include "ms5805_dispatch.h"
+#include "ms5805_sample_cell.h"
+#include "ms5805_stage.h"
 
 // Constants
 
-// MS5805 device address
-#define MS5805_ADDR 0x76 // 0b1110110
-
 // MS5805 device commands
 #define MS5805_RESET_COMMAND 0x1E
 #define MS5805_START_PRESSURE_ADC_CONVERSION 0x40
@@ -25,26 +31,49 @@
 #define MS5805_PROM_ADDRESS_READ_ADDRESS_6 0xAC
 #define MS5805_PROM_ADDRESS_READ_ADDRESS_7 0xAE
 
-// Coefficients indexes for temperature and pressure computation
+// Coefficients indexes, see ms5805_compensation.cpp for the others
 #define MS5805_CRC_INDEX 0
-#define MS5805_PRESSURE_SENSITIVITY_INDEX 1
-#define MS5805_PRESSURE_OFFSET_INDEX 2
-#define MS5805_TEMP_COEFF_OF_PRESSURE_SENSITIVITY_INDEX 3
-#define MS5805_TEMP_COEFF_OF_PRESSURE_OFFSET_INDEX 4
-#define MS5805_REFERENCE_TEMPERATURE_INDEX 5
-#define MS5805_TEMP_COEFF_OF_TEMPERATURE_INDEX 6
+
+// Instrumentation hooks, compiled out unless MS5805_ENABLE_INSTRUMENTATION
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+#define MS5805_INSTRUMENT_START(start) uint32_t start = clock->micros()
+#define MS5805_INSTRUMENT_PHASE(phase, start)                                  \
+  record_latency(phase, clock->micros() - (start))
+#define MS5805_INSTRUMENT_TRANSFER(written, read, status)                      \
+  record_transfer(written, read, status)
+#define MS5805_INSTRUMENT_BUS_CLOCK() bus->set_clock(clock)
+#define MS5805_INSTRUMENT_BUS_PHASES() record_bus_phases(bus->get_timing())
+#else
+#define MS5805_INSTRUMENT_START(start)
+#define MS5805_INSTRUMENT_PHASE(phase, start)
+#define MS5805_INSTRUMENT_TRANSFER(written, read, status)
+#define MS5805_INSTRUMENT_BUS_CLOCK()
+#define MS5805_INSTRUMENT_BUS_PHASES()
+#endif
+
+// Default time source and transport of all instances
+static ms5805_system_clock system_clock;
+#if defined(ARDUINO)
+static ms5805_wire_bus wire_bus(Wire);
+#define MS5805_DEFAULT_BUS (&wire_bus)
+#else
+#define MS5805_DEFAULT_BUS NULL
+#endif
 
 /**
 * \brief Class constructor
 *
 */
-ms5805::ms5805(void) {}
+ms5805::ms5805(void) : clock(&system_clock), bus(MS5805_DEFAULT_BUS) {
+  ms5805_set_altitude_reference(&altitude_reference, qnh);
+}
 
 /**
  * \brief Perform initial configuration. Has to be called once.
  */
 void ms5805::begin(void) {
-  Wire.begin();
+  if (bus)
+    bus->begin();
 }
 
 /**
@@ -55,8 +84,7 @@ void ms5805::begin(void) {
 *       - false : Device is not acknowledging I2C address
 */
 boolean ms5805::is_connected(void) {
-  Wire.beginTransmission((uint8_t)MS5805_ADDR);
-  return (Wire.endTransmission() == 0);
+  return (bus_write(NULL, 0) == ms5805_status_ok);
 }
 
 /**
@@ -70,19 +98,59 @@ boolean ms5805::is_connected(void) {
 *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
 */
 enum ms5805_status ms5805::write_command(uint8_t cmd) {
-  uint8_t i2c_status;
+  return bus_write(&cmd, 1);
+}
 
-  Wire.beginTransmission((uint8_t)MS5805_ADDR);
-  Wire.write(cmd);
-  i2c_status = Wire.endTransmission();
+/**
+* \brief Writes bytes to the MS5805 through the bus
+*
+* \param[in] uint8_t* : Bytes to write
+* \param[in] uint8_t : Number of bytes
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805::bus_write(const uint8_t *data, uint8_t length) {
+  enum ms5805_status status;
 
-  /* Do the transfer */
-  if (i2c_status == ms5805_STATUS_ERR_OVERFLOW)
-    return ms5805_status_no_i2c_acknowledge;
-  if (i2c_status != ms5805_STATUS_OK)
+  if (!bus)
     return ms5805_status_i2c_transfer_error;
 
-  return ms5805_status_ok;
+  MS5805_INSTRUMENT_BUS_CLOCK();
+  status = bus->write(MS5805_ADDR, data, length);
+  MS5805_INSTRUMENT_BUS_PHASES();
+  MS5805_INSTRUMENT_TRANSFER(length, 0, status);
+
+  return status;
+}
+
+/**
+* \brief Writes a command to the MS5805 then reads its answer through the bus
+*
+* \param[in] uint8_t : Command value to be written
+* \param[out] uint8_t* : Bytes read
+* \param[in] uint8_t : Number of bytes to read
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805::bus_write_read(uint8_t cmd, uint8_t *buffer,
+                                          uint8_t size) {
+  enum ms5805_status status;
+
+  if (!bus)
+    return ms5805_status_i2c_transfer_error;
+
+  MS5805_INSTRUMENT_BUS_CLOCK();
+  status = bus->write_read(MS5805_ADDR, &cmd, 1, buffer, size);
+  MS5805_INSTRUMENT_BUS_PHASES();
+  MS5805_INSTRUMENT_TRANSFER(1, size, status);
+
+  return status;
 }
 
 /**
@@ -95,6 +163,56 @@ void ms5805::set_resolution(enum ms5805_resolution_osr res) {
   ms5805_resolution_osr = res;
 }
 
+/**
+* \brief Set the time source used for conversion delays and timestamps.
+*
+* \param[in] ms5805_clock* : Clock to use, NULL restores the system clock
+*
+*/
+void ms5805::set_clock(ms5805_clock *clock) {
+  this->clock = clock ? clock : &system_clock;
+}
+
+/**
+* \brief Set the I2C transport used to reach the device.
+*
+* \param[in] ms5805_bus* : Bus to use, NULL restores the default bus
+*
+*/
+void ms5805::set_bus(ms5805_bus *bus) {
+  this->bus = bus ? bus : MS5805_DEFAULT_BUS;
+}
+
+/**
+* \brief Set the cell receiving every sample read successfully, so that other
+* threads or interrupt handlers can get the latest one.
+*
+* \param[in] ms5805_sample_cell* : Cell to publish to, NULL to stop
+*
+*/
+void ms5805::set_sample_cell(ms5805_sample_cell *cell) { sample_cell = cell; }
+
+/**
+* \brief Set the dispatcher distributing every sample read successfully to its
+* subscribers.
+*
+* \param[in] ms5805_dispatcher* : Dispatcher to publish to, NULL to stop
+*
+*/
+void ms5805::set_dispatcher(ms5805_dispatcher *dispatcher) {
+  this->dispatcher = dispatcher;
+}
+
+/**
+* \brief Set the processing applied to every sample before it is returned and
+* published : filters, decimators... Samples dropped by a stage are not
+* published.
+*
+* \param[in] ms5805_stage* : First stage of the pipeline, NULL for none
+*
+*/
+void ms5805::set_pipeline(ms5805_stage *pipeline) { this->pipeline = pipeline; }
+
 /**
 * \brief Reset the MS5805 device
 *
@@ -120,25 +238,12 @@ enum ms5805_status ms5805::reset(void) {
 *       - ms5805_status_crc_error : CRC check error on the coefficients
 */
 enum ms5805_status ms5805::read_eeprom_coeff(uint8_t command, uint16_t *coeff) {
+  enum ms5805_status status;
   uint8_t buffer[2];
-  uint8_t i;
-  uint8_t i2c_status;
-
-  buffer[0] = 0;
-  buffer[1] = 0;
 
-  /* Read data */
-  Wire.beginTransmission((uint8_t)MS5805_ADDR);
-  Wire.write(command);
-  i2c_status = Wire.endTransmission();
-
-  Wire.requestFrom((uint8_t)MS5805_ADDR, 2U);
-  for (i = 0; i < 2; i++) {
-    buffer[i] = Wire.read();
-  }
-  // Send the conversion command
-  if (i2c_status == ms5805_STATUS_ERR_OVERFLOW)
-    return ms5805_status_no_i2c_acknowledge;
+  status = bus_write_read(command, buffer, 2);
+  if (status != ms5805_status_ok)
+    return status;
 
   *coeff = (buffer[0] << 8) | buffer[1];
 
@@ -181,34 +286,7 @@ enum ms5805_status ms5805::read_eeprom(void) {
 * \return bool : TRUE if CRC is OK, FALSE if KO
 */
 boolean ms5805::crc_check(uint16_t *n_prom, uint8_t crc) {
-  uint8_t cnt, n_bit;
-  uint16_t n_rem, crc_read;
-
-  n_rem = 0x00;
-  crc_read = n_prom[0];
-  n_prom[MS5805_COEFFICIENT_COUNT] = 0;
-  n_prom[0] = (0x0FFF & (n_prom[0])); // Clear the CRC byte
-
-  for (cnt = 0; cnt < (MS5805_COEFFICIENT_COUNT + 1) * 2; cnt++) {
-
-    // Get next byte
-    if (cnt % 2 == 1)
-      n_rem ^= n_prom[cnt >> 1] & 0x00FF;
-    else
-      n_rem ^= n_prom[cnt >> 1] >> 8;
-
-    for (n_bit = 8; n_bit > 0; n_bit--) {
-
-      if (n_rem & 0x8000)
-        n_rem = (n_rem << 1) ^ 0x3000;
-      else
-        n_rem <<= 1;
-    }
-  }
-  n_rem >>= 12;
-  n_prom[0] = crc_read;
-
-  return (n_rem == crc);
+  return (ms5805_prom_crc(n_prom) == crc);
 }
 
 /**
@@ -225,41 +303,153 @@ boolean ms5805::crc_check(uint16_t *n_prom, uint8_t crc) {
 */
 enum ms5805_status ms5805::conversion_and_read_adc(uint8_t cmd, uint32_t *adc) {
   enum ms5805_status status;
-  uint8_t i2c_status;
+
+  // Send the conversion command
+  status = write_command(cmd);
+  if (status != ms5805_status_ok)
+    return status;
+
+  // delay conversion depending on resolution
+  MS5805_INSTRUMENT_START(conversion_start);
+  clock->delay(conversion_time[(cmd & MS5805_CONVERSION_OSR_MASK) / 2]);
+  MS5805_INSTRUMENT_PHASE(ms5805_phase_conversion, conversion_start);
+
+  // Send the read command and get the result
+  return read_adc(adc);
+}
+
+/**
+* \brief Starts an ADC conversion at the current resolution, without waiting
+* for its completion.
+*
+* \param[in] ms5805_measurement : Temperature or pressure conversion
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status
+ms5805::start_conversion(enum ms5805_measurement measurement) {
+  return write_command(get_conversion_command(measurement));
+}
+
+/**
+* \brief Reads the result of the last conversion, which has to be complete.
+*
+* \param[out] uint32_t* : ADC value
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805::read_adc(uint32_t *adc) {
+  enum ms5805_status status;
   uint8_t buffer[3];
-  uint8_t i;
 
-  /* Read data */
-  Wire.beginTransmission((uint8_t)MS5805_ADDR);
-  Wire.write((uint8_t)cmd);
-  Wire.endTransmission();
+  status = bus_write_read(MS5805_READ_ADC, buffer, 3);
+  if (status != ms5805_status_ok)
+    return status;
 
-  delay(conversion_time[(cmd & MS5805_CONVERSION_OSR_MASK) / 2]);
+  *adc = ((uint32_t)buffer[0] << 16) | ((uint32_t)buffer[1] << 8) | buffer[2];
 
-  Wire.beginTransmission((uint8_t)MS5805_ADDR);
-  Wire.write((uint8_t)0x00);
-  i2c_status = Wire.endTransmission();
+  return ms5805_status_ok;
+}
 
-  Wire.requestFrom((uint8_t)MS5805_ADDR, 3U);
-  for (i = 0; i < 3; i++) {
-    buffer[i] = Wire.read();
-  }
+/**
+* \brief Command starting a conversion at the current resolution.
+*
+* \param[in] ms5805_measurement : Temperature or pressure conversion
+*
+* \return uint8_t : Command value
+*/
+uint8_t ms5805::get_conversion_command(enum ms5805_measurement measurement) {
+  uint8_t cmd = ms5805_resolution_osr * 2;
+
+  if (measurement == ms5805_measurement_temperature)
+    cmd |= MS5805_START_TEMPERATURE_ADC_CONVERSION;
+  else
+    cmd |= MS5805_START_PRESSURE_ADC_CONVERSION;
+
+  return cmd;
+}
+
+/**
+* \brief Duration of a conversion at the current resolution.
+*
+* \return uint32_t : Conversion time in ms
+*/
+uint32_t ms5805::get_conversion_time(void) {
+  return conversion_time[ms5805_resolution_osr];
+}
+
+/**
+* \brief Reads the raw temperature (D2) and pressure (D1) ADC values, without
+* compensation.
+*
+* \param[out] uint32_t* : Temperature ADC value
+* \param[out] uint32_t* : Pressure ADC value
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*/
+enum ms5805_status ms5805::read_raw_adc(uint32_t *adc_temperature,
+                                       uint32_t *adc_pressure) {
+  enum ms5805_status status = ms5805_status_ok;
+
+  // If first time adc is requested, get EEPROM coefficients
+  if (coeff_read == false)
+    status = read_eeprom();
 
-  // delay conversion depending on resolution
   if (status != ms5805_status_ok)
     return status;
 
-  // Send the read command
-  // status = ms5805_write_command(MS5805_READ_ADC);
+  // First read temperature
+  status = conversion_and_read_adc(
+      get_conversion_command(ms5805_measurement_temperature), adc_temperature);
   if (status != ms5805_status_ok)
     return status;
 
-  if (i2c_status == ms5805_STATUS_ERR_OVERFLOW)
-    return ms5805_status_no_i2c_acknowledge;
-  if (i2c_status != ms5805_STATUS_OK)
+  // Now read pressure
+  status = conversion_and_read_adc(
+      get_conversion_command(ms5805_measurement_pressure), adc_pressure);
+  if (status != ms5805_status_ok)
+    return status;
+
+  if (*adc_temperature == 0 || *adc_pressure == 0)
     return ms5805_status_i2c_transfer_error;
 
-  *adc = ((uint32_t)buffer[0] << 16) | ((uint32_t)buffer[1] << 8) | buffer[2];
+  return status;
+}
+
+/**
+* \brief Reads the PROM coefficients used for compensation, to store them
+* along with raw ADC values.
+*
+* \param[out] uint16_t* : MS5805_COEFFICIENT_COUNT coefficients
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*/
+enum ms5805_status ms5805::read_coefficients(uint16_t *coeff) {
+  enum ms5805_status status = ms5805_status_ok;
+  uint8_t i;
+
+  if (coeff_read == false)
+    status = read_eeprom();
+
+  if (status != ms5805_status_ok)
+    return status;
+
+  for (i = 0; i < MS5805_COEFFICIENT_COUNT; i++)
+    coeff[i] = eeprom_coeff[i];
 
   return status;
 }
@@ -276,85 +466,621 @@ enum ms5805_status ms5805::conversion_and_read_adc(uint8_t cmd, uint32_t *adc) {
 *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
 *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
 *       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline
 */
 enum ms5805_status ms5805::read_temperature_and_pressure(float *temperature,
                                                          float *pressure) {
   enum ms5805_status status = ms5805_status_ok;
-  uint32_t adc_temperature, adc_pressure;
-  int32_t dT, TEMP;
-  int64_t OFF, SENS, P, T2, OFF2, SENS2;
-  uint8_t cmd;
+  struct ms5805_sample sample;
 
-  // If first time adc is requested, get EEPROM coefficients
-  if (coeff_read == false)
-    status = read_eeprom();
+  status = read_sample(&sample);
+  if (status != ms5805_status_ok)
+    return status;
+
+  *temperature = (float)sample.temperature / 100;
+  *pressure = (float)sample.pressure / 100;
+
+  return status;
+}
+
+/**
+* \brief Reads the temperature and pressure ADC value and compute the
+* compensated values in integer units, along with the acquisition time.
+*
+* \param[out] ms5805_sample* : Compensated sample
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+*/
+enum ms5805_status ms5805::read_sample(struct ms5805_sample *sample) {
+  enum ms5805_status status = ms5805_status_ok;
+
+  if (!claim_bus())
+    return ms5805_status_busy;
+
+  sample->timestamp = clock->micros();
+  sample->flags = 0;
+  status = read_raw_adc(&sample->adc_temperature, &sample->adc_pressure);
+  if (status == ms5805_status_ok) {
+    compensate_sample(sample);
+    status = process_sample(sample);
+  }
+
+  release_bus();
+
+  if (status == ms5805_status_ok)
+    publish_sample(sample);
+
+  return status;
+}
+
+/**
+* \brief Set how long a sample is reused by the cached read functions.
+*
+* \param[in] uint32_t : Time to live in ms from the acquisition of the sample,
+* up to MS5805_MAX_CACHE_TTL_MS, 0 disables the cache
+*
+*/
+void ms5805::set_cache_ttl(uint32_t ttl_ms) {
+  if (ttl_ms > MS5805_MAX_CACHE_TTL_MS)
+    ttl_ms = MS5805_MAX_CACHE_TTL_MS;
+  cache_ttl = ttl_ms * 1000;
+}
+
+/**
+* \brief Returns the last sample if it is younger than the cache time to live,
+* otherwise reads a new one. A request made while another read is in progress,
+* from an interrupt handler or a callback, gets the last sample instead of
+* starting a second bus operation.
+*
+* \param[out] ms5805_sample* : Compensated sample
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : Sample available
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_busy : Read in progress and no sample yet
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline and no
+* sample yet
+*/
+enum ms5805_status ms5805::read_cached_sample(struct ms5805_sample *sample) {
+  enum ms5805_status status;
+
+  // The cell gives a consistent copy, or fails when the sample is being
+  // replaced, which the read below then reports as busy
+  if (cache.try_read(sample) &&
+      clock->micros() - sample->timestamp < cache_ttl)
+    return ms5805_status_ok;
+
+  status = read_sample(sample);
+
+  // Coalesce with the read in progress, or hold the last sample which went
+  // through the pipeline
+  if ((status == ms5805_status_busy ||
+       status == ms5805_status_sample_dropped) &&
+      cache.try_read(sample))
+    status = ms5805_status_ok;
+
+  return status;
+}
+
+/**
+* \brief Cached version of read_temperature_and_pressure(), see
+* read_cached_sample().
+*
+* \param[out] float* : Celsius Degree temperature value
+* \param[out] float* : mbar pressure value
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : Sample available
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_busy : Read in progress and no sample yet
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline and no
+* sample yet
+*/
+enum ms5805_status
+ms5805::read_cached_temperature_and_pressure(float *temperature,
+                                             float *pressure) {
+  enum ms5805_status status = ms5805_status_ok;
+  struct ms5805_sample sample;
 
+  status = read_cached_sample(&sample);
   if (status != ms5805_status_ok)
     return status;
 
-  // First read temperature
-  cmd = ms5805_resolution_osr * 2;
-  cmd |= MS5805_START_TEMPERATURE_ADC_CONVERSION;
-  status = conversion_and_read_adc(cmd, &adc_temperature);
+  *temperature = (float)sample.temperature / 100;
+  *pressure = (float)sample.pressure / 100;
+
+  return status;
+}
+
+/**
+* \brief Set the sea-level pressure (QNH) used by read_altitude().
+*
+* \param[in] float : QNH in mbar, 1013.25 by default
+*
+*/
+void ms5805::set_qnh(float qnh) {
+  this->qnh = (int32_t)(qnh * 100 + 0.5f);
+  ms5805_set_altitude_reference(&altitude_reference, this->qnh);
+}
+
+/**
+* \brief Compute the QNH from the average pressure of several samples read at
+* a known altitude. Samples dropped by the pipeline are left out.
+*
+* \param[in] float : Altitude of the sensor in m
+* \param[in] uint8_t : Number of samples to read
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : QNH updated
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_busy : Read or measurement in progress
+*       - ms5805_status_sample_dropped : All samples dropped by the pipeline
+*/
+enum ms5805_status ms5805::calibrate_qnh(float altitude, uint8_t samples) {
+  enum ms5805_status status;
+  struct ms5805_sample sample;
+  int32_t sum = 0;
+  uint8_t i, count = 0;
+
+  for (i = 0; i < samples; i++) {
+    status = read_sample(&sample);
+    if (status == ms5805_status_sample_dropped)
+      continue;
+    if (status != ms5805_status_ok)
+      return status;
+    sum += sample.pressure;
+    count++;
+  }
+  if (count == 0)
+    return ms5805_status_sample_dropped;
+
+  ms5805_calibrate_altitude_reference(
+      &altitude_reference, (sum + count / 2) / count,
+      (int32_t)(altitude * 100 + (altitude < 0 ? -0.5f : 0.5f)));
+  qnh = ms5805_reference_pressure(&altitude_reference);
+
+  return ms5805_status_ok;
+}
+
+/**
+* \brief Returns the sea-level pressure (QNH) used by read_altitude().
+*
+* \return float : QNH in mbar
+*/
+float ms5805::get_qnh(void) { return (float)qnh / 100; }
+
+/**
+* \brief Returns the altitude reference derived from the QNH, to convert
+* samples to altitude with ms5805_altitude_cm() or ms5805_altitude().
+*
+* \return ms5805_altitude_reference* : Reference
+*/
+const struct ms5805_altitude_reference *ms5805::get_altitude_reference(void) {
+  return &altitude_reference;
+}
+
+/**
+* \brief Reads a sample and computes its altitude above the QNH level.
+*
+* \param[out] float* : Altitude in m
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+*/
+enum ms5805_status ms5805::read_altitude(float *altitude) {
+  enum ms5805_status status = ms5805_status_ok;
+  struct ms5805_sample sample;
+
+  status = read_sample(&sample);
   if (status != ms5805_status_ok)
     return status;
 
-  // Now read pressure
-  cmd = ms5805_resolution_osr * 2;
-  cmd |= MS5805_START_PRESSURE_ADC_CONVERSION;
-  status = conversion_and_read_adc(cmd, &adc_pressure);
+  *altitude = (float)ms5805_altitude_cm(sample.pressure, &altitude_reference) /
+              100;
+
+  return status;
+}
+
+/**
+* \brief Computes the compensated values from ADC values acquired with
+* start_conversion() and read_adc().
+*
+* \param[in] uint32_t : Temperature ADC value
+* \param[in] uint32_t : Pressure ADC value
+* \param[out] float* : Celsius Degree temperature value
+* \param[out] float* : mbar pressure value
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*/
+enum ms5805_status ms5805::compute_temperature_and_pressure(
+    uint32_t adc_temperature, uint32_t adc_pressure, float *temperature,
+    float *pressure) {
+  enum ms5805_status status = ms5805_status_ok;
+  int32_t TEMP, P;
+
+  if (coeff_read == false)
+    status = read_eeprom();
+
   if (status != ms5805_status_ok)
     return status;
 
   if (adc_temperature == 0 || adc_pressure == 0)
     return ms5805_status_i2c_transfer_error;
 
-  // Difference between actual and reference temperature = D2 - Tref
-  dT = (int32_t)adc_temperature -
-       ((int32_t)eeprom_coeff[MS5805_REFERENCE_TEMPERATURE_INDEX] << 8);
-
-  // Actual temperature = 2000 + dT * TEMPSENS
-  TEMP = 2000 +
-         ((int64_t)dT *
-              (int64_t)eeprom_coeff[MS5805_TEMP_COEFF_OF_TEMPERATURE_INDEX] >>
-          23);
-
-  // Second order temperature compensation
-  if (TEMP < 2000) {
-    T2 = (3 * ((int64_t)dT * (int64_t)dT)) >> 33;
-    OFF2 = 61 * ((int64_t)TEMP - 2000) * ((int64_t)TEMP - 2000) / 16;
-    SENS2 = 29 * ((int64_t)TEMP - 2000) * ((int64_t)TEMP - 2000) / 16;
-
-    if (TEMP < -1500) {
-      OFF2 += 17 * ((int64_t)TEMP + 1500) * ((int64_t)TEMP + 1500);
-      SENS2 += 9 * ((int64_t)TEMP + 1500) * ((int64_t)TEMP + 1500);
+  MS5805_INSTRUMENT_START(compensation_start);
+
+  ms5805_compensate(eeprom_coeff, adc_temperature, adc_pressure, &TEMP, &P);
+
+  *temperature = (float)TEMP / 100;
+  *pressure = (float)P / 100;
+
+  MS5805_INSTRUMENT_PHASE(ms5805_phase_compensation, compensation_start);
+
+  return status;
+}
+
+/**
+* \brief Set the function called each time a background measurement completes,
+* see start_measurement().
+*
+* \param[in] ms5805_sample_callback : Function to call, NULL for none
+* \param[in] void* : Context passed to the function
+*
+*/
+void ms5805::set_sample_callback(ms5805_sample_callback callback,
+                                 void *context) {
+  sample_callback = callback;
+  sample_callback_context = context;
+}
+
+/**
+* \brief Start a background measurement : conversions are started here and
+* read by poll() once complete, without waiting in between. The sample callback
+* is then called, and the sample published like read_sample() does.
+*
+* \param[in] bool : Start a new measurement as soon as one completes
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : Measurement started
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_busy : Read or measurement already in progress
+*/
+enum ms5805_status ms5805::start_measurement(bool continuous) {
+  enum ms5805_status status;
+
+  status = begin_measurement(&measurement_state, &measurement);
+  if (status != ms5805_status_ok)
+    return status;
+
+  conversion_start = measurement.timestamp;
+  this->continuous = continuous;
+
+  return status;
+}
+
+/**
+* \brief Stop continuous measurements once the one in progress completes.
+*/
+void ms5805::stop_measurement(void) { continuous = false; }
+
+/**
+* \brief Advance the background measurement when its conversion is complete.
+* Cheap when nothing is due, to be called from loop() or from a timer interrupt
+* handler as often as the callback latency requires.
+*/
+void ms5805::poll(void) {
+  enum ms5805_status status;
+
+  if (measurement_state == ms5805_measurement_state_idle)
+    return;
+
+  if (clock->micros() - conversion_start < get_conversion_time() * 1000UL)
+    return;
+
+  status = advance_measurement(&measurement_state, &measurement);
+  if (measurement_state != ms5805_measurement_state_idle)
+    conversion_start = clock->micros();
+  else
+    complete_measurement(status);
+}
+
+/**
+* \brief Current step of the background measurement.
+*
+* \return ms5805_measurement_state : idle, or the conversion in progress
+*/
+enum ms5805_measurement_state ms5805::get_measurement_state(void) {
+  return measurement_state;
+}
+
+/**
+* \brief Claim the bus and start the temperature conversion of a split-phase
+* measurement.
+*
+* \param[out] ms5805_measurement_state* : Step of the measurement
+* \param[out] ms5805_sample* : Sample, timestamped
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : Measurement started
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_crc_error : CRC check error on the coefficients
+*       - ms5805_status_busy : Read or measurement already in progress
+*/
+enum ms5805_status
+ms5805::begin_measurement(volatile enum ms5805_measurement_state *state,
+                          struct ms5805_sample *sample) {
+  enum ms5805_status status = ms5805_status_ok;
+
+  if (!claim_bus())
+    return ms5805_status_busy;
+
+  if (coeff_read == false)
+    status = read_eeprom();
+
+  if (status == ms5805_status_ok)
+    status = start_conversion(ms5805_measurement_temperature);
+
+  if (status != ms5805_status_ok) {
+    release_bus();
+    return status;
+  }
+
+  sample->timestamp = clock->micros();
+  sample->flags = 0;
+  *state = ms5805_measurement_state_temperature;
+
+  return status;
+}
+
+/**
+* \brief Read the conversion of a split-phase measurement once complete, and
+* start the next one. After the pressure, or on error, the measurement ends :
+* the bus is released and a valid sample is compensated and published.
+*
+* \param[in,out] ms5805_measurement_state* : Step of the measurement, idle
+* once it ended
+* \param[in,out] ms5805_sample* : Sample
+*
+* \return ms5805_status : status of MS5805
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+*/
+enum ms5805_status
+ms5805::advance_measurement(volatile enum ms5805_measurement_state *state,
+                            struct ms5805_sample *sample) {
+  enum ms5805_status status;
+
+  if (*state == ms5805_measurement_state_temperature) {
+    status = read_adc(&sample->adc_temperature);
+    if (status == ms5805_status_ok)
+      status = start_conversion(ms5805_measurement_pressure);
+
+    if (status == ms5805_status_ok) {
+      *state = ms5805_measurement_state_pressure;
+      return status;
     }
   } else {
-    T2 = (5 * ((int64_t)dT * (int64_t)dT)) >> 38;
-    OFF2 = 0;
-    SENS2 = 0;
+    status = read_adc(&sample->adc_pressure);
+    if (status == ms5805_status_ok &&
+        (sample->adc_temperature == 0 || sample->adc_pressure == 0))
+      status = ms5805_status_i2c_transfer_error;
   }
 
-  // OFF = OFF_T1 + TCO * dT
-  OFF = ((int64_t)(eeprom_coeff[MS5805_PRESSURE_OFFSET_INDEX]) << 17) +
-        (((int64_t)(eeprom_coeff[MS5805_TEMP_COEFF_OF_PRESSURE_OFFSET_INDEX]) *
-          dT) >>
-         6);
-  OFF -= OFF2;
-
-  // Sensitivity at actual temperature = SENS_T1 + TCS * dT
-  SENS =
-      ((int64_t)eeprom_coeff[MS5805_PRESSURE_SENSITIVITY_INDEX] << 16) +
-      (((int64_t)eeprom_coeff[MS5805_TEMP_COEFF_OF_PRESSURE_SENSITIVITY_INDEX] *
-        dT) >>
-       7);
-  SENS -= SENS2;
-
-  // Temperature compensated pressure = D1 * SENS - OFF
-  P = (((adc_pressure * SENS) >> 21) - OFF) >> 15;
-
-  *temperature = ((float)TEMP - T2) / 100;
-  *pressure = (float)P / 100;
+  if (status == ms5805_status_ok) {
+    compensate_sample(sample);
+    status = process_sample(sample);
+  }
+
+  *state = ms5805_measurement_state_idle;
+  release_bus();
+
+  if (status == ms5805_status_ok)
+    publish_sample(sample);
 
   return status;
 }
+
+/**
+* \brief End the background measurement : notify the callback and start the
+* next measurement in continuous mode.
+*
+* \param[in] ms5805_status : Outcome of the measurement
+*/
+void ms5805::complete_measurement(enum ms5805_status status) {
+  float temperature = 0, pressure = 0;
+
+  if (status == ms5805_status_ok) {
+    temperature = (float)measurement.temperature / 100;
+    pressure = (float)measurement.pressure / 100;
+  }
+
+  if (sample_callback && status != ms5805_status_sample_dropped)
+    sample_callback(temperature, pressure, status, measurement.timestamp,
+                    sample_callback_context);
+
+  // The callback may have stopped the measurements or started one itself
+  if (continuous && measurement_state == ms5805_measurement_state_idle) {
+    status = start_measurement(true);
+    if (status != ms5805_status_ok) {
+      continuous = false;
+      if (sample_callback)
+        sample_callback(0, 0, status, clock->micros(),
+                        sample_callback_context);
+    }
+  }
+}
+
+/**
+* \brief Mark the start of an acquisition, unless one is already in progress.
+*
+* \return bool : false if another acquisition is in progress
+*/
+bool ms5805::claim_bus(void) {
+#if defined(__AVR__)
+  bool claimed = false;
+
+  // An interrupt handler claiming the bus between the test and the set
+  // would start a second transfer : both are done with interrupts off
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (!busy) {
+      busy = true;
+      claimed = true;
+    }
+  }
+  return claimed;
+#else
+  return !__atomic_test_and_set(&busy, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+* \brief Mark the end of an acquisition.
+*/
+void ms5805::release_bus(void) {
+#if defined(__AVR__)
+  busy = false;
+#else
+  __atomic_clear(&busy, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+* \brief Compute the compensated values of a sample from its ADC values. The
+* coefficients have to be read already.
+*
+* \param[in,out] ms5805_sample* : Sample
+*/
+void ms5805::compensate_sample(struct ms5805_sample *sample) {
+  MS5805_INSTRUMENT_START(compensation_start);
+
+  ms5805_compensate(eeprom_coeff, sample->adc_temperature,
+                    sample->adc_pressure, &sample->temperature,
+                    &sample->pressure);
+
+  MS5805_INSTRUMENT_PHASE(ms5805_phase_compensation, compensation_start);
+}
+
+/**
+* \brief Run a new sample through the pipeline and store it in the cache.
+* Called with the bus claimed, so that the cache has a single writer.
+*
+* \param[in,out] ms5805_sample* : Sample, processed in place
+*
+* \return ms5805_status : status of the sample
+*       - ms5805_status_ok : Sample kept
+*       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+*/
+enum ms5805_status ms5805::process_sample(struct ms5805_sample *sample) {
+  if (pipeline && !pipeline->run(sample))
+    return ms5805_status_sample_dropped;
+
+  cache.publish(sample);
+
+  return ms5805_status_ok;
+}
+
+/**
+* \brief Hand a processed sample over to its consumers.
+*
+* \param[in] ms5805_sample* : Sample
+*/
+void ms5805::publish_sample(const struct ms5805_sample *sample) {
+  if (sample_cell)
+    sample_cell->publish(sample);
+  if (dispatcher)
+    dispatcher->publish(sample);
+}
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+/**
+* \brief Copy the I2C instrumentation counters and latency histograms.
+*
+* \param[out] ms5805_instrumentation* : Snapshot of the counters
+*/
+void ms5805::get_instrumentation(struct ms5805_instrumentation *snapshot) {
+  *snapshot = instrumentation;
+}
+
+/**
+* \brief Clear the I2C instrumentation counters and latency histograms.
+*/
+void ms5805::reset_instrumentation(void) {
+  memset(&instrumentation, 0, sizeof(instrumentation));
+}
+
+/**
+* \brief Account for an I2C transaction
+*
+* \param[in] uint8_t : Number of bytes written
+* \param[in] uint8_t : Number of bytes to read
+* \param[in] ms5805_status : Status of the transaction
+*/
+void ms5805::record_transfer(uint8_t written, uint8_t read,
+                             enum ms5805_status status) {
+  instrumentation.transactions++;
+  instrumentation.bytes_written += written;
+  if (status == ms5805_status_ok)
+    instrumentation.bytes_read += read;
+  else if (status == ms5805_status_no_i2c_acknowledge)
+    instrumentation.nacks++;
+  else
+    instrumentation.errors++;
+}
+
+/**
+* \brief Add the write and read phases timed by the bus during a transfer
+*
+* \param[in] ms5805_bus_timing* : Timing of the transfer
+*/
+void ms5805::record_bus_phases(const struct ms5805_bus_timing *timing) {
+  if (timing->write_timed)
+    record_latency(ms5805_phase_write, timing->write_us);
+  if (timing->read_timed)
+    record_latency(ms5805_phase_read, timing->read_us);
+}
+
+/**
+* \brief Add a latency measurement to the histogram of a phase
+*
+* \param[in] ms5805_phase : Phase measured
+* \param[in] uint32_t : Latency in us
+*/
+void ms5805::record_latency(enum ms5805_phase phase, uint32_t latency_us) {
+  uint8_t bucket = 0;
+  uint16_t *count;
+
+  // Bucket is the number of significant bits of the latency
+  while (latency_us >> bucket && bucket < MS5805_INSTRUMENTATION_BUCKETS - 1)
+    bucket++;
+
+  count = &instrumentation.histogram[phase][bucket];
+  if (*count != UINT16_MAX)
+    (*count)++;
+  if (latency_us > instrumentation.max_latency_us[phase])
+    instrumentation.max_latency_us[phase] = latency_us;
+}
+#endif
@@ -1,8 +1,31 @@
+#ifndef MS5805_H
+#define MS5805_H
+
 #if defined(ARDUINO) && ARDUINO >= 100
 #include "Arduino.h"
-#else
+#elif defined(ARDUINO)
 #include "WProgram.h"
+#else
+#include <stddef.h>
+#include <stdint.h>
+typedef bool boolean;
+#endif
+
+#include "ms5805_altitude.h"
+#include "ms5805_clock.h"
+#include "ms5805_config.h"
+#include "ms5805_sample.h"
+#include "ms5805_sample_cell.h"
+
+// Coroutine API, see ms5805_coroutine.h
+#if defined(__cplusplus) && __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#define MS5805_HAS_COROUTINES
 #endif
+#endif
+
+// MS5805 device address
+#define MS5805_ADDR 0x76 // 0b1110110
 
 #define MS5805_COEFFICIENT_COUNT 7
 
@@ -13,6 +36,14 @@
 #define MS5805_CONVERSION_TIME_OSR_4096 9
 #define MS5805_CONVERSION_TIME_OSR_8192 17
 
+// Longest cache time to live : sample ages are measured on the 32-bits
+// microseconds clock
+#define MS5805_MAX_CACHE_TTL_MS 2000000UL
+
+// Number of log2 latency buckets : bucket 0 counts 0us, bucket n counts
+// [2^(n-1), 2^n[ us and the last bucket also collects all longer latencies
+#define MS5805_INSTRUMENTATION_BUCKETS 20
+
 // Enum
 enum ms5805_resolution_osr {
   ms5805_resolution_osr_256 = 0,
@@ -23,19 +54,74 @@ enum ms5805_resolution_osr {
   ms5805_resolution_osr_8192
 };
 
+enum ms5805_measurement {
+  ms5805_measurement_temperature,
+  ms5805_measurement_pressure
+};
+
 enum ms5805_status {
   ms5805_status_ok,
   ms5805_status_no_i2c_acknowledge,
   ms5805_status_i2c_transfer_error,
-  ms5805_status_crc_error
+  ms5805_status_crc_error,
+  ms5805_status_busy,
+  ms5805_status_sample_dropped
 };
 
 enum ms5805_status_code {
   ms5805_STATUS_OK = 0,
   ms5805_STATUS_ERR_OVERFLOW = 1,
+  ms5805_STATUS_ERR_ADDRESS_NACK = 2,
+  ms5805_STATUS_ERR_DATA_NACK = 3,
   ms5805_STATUS_ERR_TIMEOUT = 4
 };
 
+enum ms5805_phase {
+  ms5805_phase_write,        // I2C write, up to the end of transmission
+  ms5805_phase_read,         // I2C read of the answer, with the command
+                             // write on buses issuing both in one request
+  ms5805_phase_conversion,   // Wait for the ADC conversion to complete
+  ms5805_phase_compensation, // Temperature and pressure computation
+  ms5805_phase_count
+};
+
+enum ms5805_measurement_state {
+  ms5805_measurement_state_idle,
+  ms5805_measurement_state_temperature, // D2 conversion in progress
+  ms5805_measurement_state_pressure     // D1 conversion in progress
+};
+
+// Instrumentation snapshot, see MS5805_ENABLE_INSTRUMENTATION
+struct ms5805_instrumentation {
+  uint32_t transactions;
+  uint32_t bytes_written;
+  uint32_t bytes_read;
+  uint32_t nacks;
+  uint32_t errors;
+  uint32_t max_latency_us[ms5805_phase_count];
+  uint16_t histogram[ms5805_phase_count][MS5805_INSTRUMENTATION_BUCKETS];
+};
+
+/**
+ * \brief Function called when a background measurement completes.
+ *
+ * \param[in] float : Celsius Degree temperature value
+ * \param[in] float : mbar pressure value
+ * \param[in] ms5805_status : status of the measurement, values are 0 unless
+ * ms5805_status_ok
+ * \param[in] uint32_t : Start of the acquisition in us
+ * \param[in] void* : Context given with the callback
+ */
+typedef void (*ms5805_sample_callback)(float temperature, float pressure,
+                                       enum ms5805_status status,
+                                       uint32_t timestamp, void *context);
+
+class ms5805_bus;
+class ms5805_dispatcher;
+class ms5805_stage;
+class ms5805_scheduler;
+class ms5805_measure_operation;
+
 // Functions
 class ms5805 {
 
@@ -74,6 +160,51 @@ public:
   */
   void set_resolution(enum ms5805_resolution_osr res);
 
+  /**
+  * \brief Set the time source used for conversion delays and timestamps.
+  *
+  * \param[in] ms5805_clock* : Clock to use, NULL restores the system clock
+  *
+  */
+  void set_clock(ms5805_clock *clock);
+
+  /**
+  * \brief Set the I2C transport used to reach the device. Defaults to the
+  * Wire library on Arduino, and has to be set on other platforms.
+  *
+  * \param[in] ms5805_bus* : Bus to use, NULL restores the default bus
+  *
+  */
+  void set_bus(ms5805_bus *bus);
+
+  /**
+  * \brief Set the cell receiving every sample read successfully, so that
+  * other threads or interrupt handlers can get the latest one.
+  *
+  * \param[in] ms5805_sample_cell* : Cell to publish to, NULL to stop
+  *
+  */
+  void set_sample_cell(ms5805_sample_cell *cell);
+
+  /**
+  * \brief Set the dispatcher distributing every sample read successfully to
+  * its subscribers.
+  *
+  * \param[in] ms5805_dispatcher* : Dispatcher to publish to, NULL to stop
+  *
+  */
+  void set_dispatcher(ms5805_dispatcher *dispatcher);
+
+  /**
+  * \brief Set the processing applied to every sample before it is returned
+  * and published : filters, decimators... Samples dropped by a stage are
+  * not published.
+  *
+  * \param[in] ms5805_stage* : First stage of the pipeline, NULL for none
+  *
+  */
+  void set_pipeline(ms5805_stage *pipeline);
+
   /**
   * \brief Reads the temperature and pressure ADC value and compute the
   * compensated values.
@@ -87,16 +218,329 @@ public:
   *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
   *       - ms5805_status_crc_error : CRC check error on on the PROM
   * coefficients
+  *       - ms5805_status_sample_dropped : Sample dropped by the pipeline
   */
   enum ms5805_status read_temperature_and_pressure(float *temperature,
                                                    float *pressure);
 
+  /**
+  * \brief Reads the temperature and pressure ADC value and compute the
+  * compensated values in integer units, along with the acquisition time.
+  *
+  * \param[out] ms5805_sample* : Compensated sample
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+  */
+  enum ms5805_status read_sample(struct ms5805_sample *sample);
+
+  /**
+  * \brief Set how long a sample is reused by the cached read functions.
+  *
+  * \param[in] uint32_t : Time to live in ms from the acquisition of the
+  * sample, up to MS5805_MAX_CACHE_TTL_MS, 0 disables the cache
+  *
+  */
+  void set_cache_ttl(uint32_t ttl_ms);
+
+  /**
+  * \brief Returns the last sample if it is younger than the cache time to
+  * live, otherwise reads a new one. A request made while another read is in
+  * progress, from an interrupt handler or a callback, gets the last sample
+  * instead of starting a second bus operation.
+  *
+  * \param[out] ms5805_sample* : Compensated sample
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : Sample available
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_busy : Read in progress and no sample yet
+  *       - ms5805_status_sample_dropped : Sample dropped by the pipeline and
+  * no sample yet
+  */
+  enum ms5805_status read_cached_sample(struct ms5805_sample *sample);
+
+  /**
+  * \brief Cached version of read_temperature_and_pressure(), see
+  * read_cached_sample().
+  *
+  * \param[out] float* : Celsius Degree temperature value
+  * \param[out] float* : mbar pressure value
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : Sample available
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_busy : Read in progress and no sample yet
+  *       - ms5805_status_sample_dropped : Sample dropped by the pipeline and
+  * no sample yet
+  */
+  enum ms5805_status read_cached_temperature_and_pressure(float *temperature,
+                                                          float *pressure);
+
+  /**
+  * \brief Set the sea-level pressure (QNH) used by read_altitude().
+  *
+  * \param[in] float : QNH in mbar, 1013.25 by default
+  *
+  */
+  void set_qnh(float qnh);
+
+  /**
+  * \brief Compute the QNH from the average pressure of several samples read
+  * at a known altitude. Samples dropped by the pipeline are left out.
+  *
+  * \param[in] float : Altitude of the sensor in m
+  * \param[in] uint8_t : Number of samples to read
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : QNH updated
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_busy : Read or measurement in progress
+  *       - ms5805_status_sample_dropped : All samples dropped by the pipeline
+  */
+  enum ms5805_status calibrate_qnh(float altitude, uint8_t samples);
+
+  /**
+  * \brief Returns the sea-level pressure (QNH) used by read_altitude().
+  *
+  * \return float : QNH in mbar
+  */
+  float get_qnh(void);
+
+  /**
+  * \brief Returns the altitude reference derived from the QNH, to convert
+  * samples to altitude with ms5805_altitude_cm() or ms5805_altitude().
+  *
+  * \return ms5805_altitude_reference* : Reference
+  */
+  const struct ms5805_altitude_reference *get_altitude_reference(void);
+
+  /**
+  * \brief Reads a sample and computes its altitude above the QNH level.
+  *
+  * \param[out] float* : Altitude in m
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_sample_dropped : Sample dropped by the pipeline
+  */
+  enum ms5805_status read_altitude(float *altitude);
+
+  /**
+  * \brief Set the function called each time a background measurement
+  * completes, see start_measurement().
+  *
+  * \param[in] ms5805_sample_callback : Function to call, NULL for none
+  * \param[in] void* : Context passed to the function
+  *
+  */
+  void set_sample_callback(ms5805_sample_callback callback,
+                           void *context = NULL);
+
+  /**
+  * \brief Start a background measurement : conversions are started here and
+  * read by poll() once complete, without waiting in between. The sample
+  * callback is then called, and the sample published like read_sample()
+  * does.
+  *
+  * \param[in] bool : Start a new measurement as soon as one completes
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : Measurement started
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  *       - ms5805_status_busy : Read or measurement already in progress
+  */
+  enum ms5805_status start_measurement(bool continuous = false);
+
+  /**
+  * \brief Stop continuous measurements once the one in progress completes.
+  */
+  void stop_measurement(void);
+
+  /**
+  * \brief Advance the background measurement when its conversion is
+  * complete. Cheap when nothing is due, to be called from loop() or from a
+  * timer interrupt handler as often as the callback latency requires.
+  */
+  void poll(void);
+
+  /**
+  * \brief Current step of the background measurement.
+  *
+  * \return ms5805_measurement_state : idle, or the conversion in progress
+  */
+  enum ms5805_measurement_state get_measurement_state(void);
+
+  /**
+  * \brief Reads the raw temperature (D2) and pressure (D1) ADC values, without
+  * compensation.
+  *
+  * \param[out] uint32_t* : Temperature ADC value
+  * \param[out] uint32_t* : Pressure ADC value
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  */
+  enum ms5805_status read_raw_adc(uint32_t *adc_temperature,
+                                  uint32_t *adc_pressure);
+
+  /**
+  * \brief Reads the PROM coefficients used for compensation, to store them
+  * along with raw ADC values.
+  *
+  * \param[out] uint16_t* : MS5805_COEFFICIENT_COUNT coefficients
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  */
+  enum ms5805_status read_coefficients(uint16_t *coeff);
+
+  /**
+  * \brief Starts an ADC conversion at the current resolution, without
+  * waiting for its completion.
+  *
+  * \param[in] ms5805_measurement : Temperature or pressure conversion
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  */
+  enum ms5805_status start_conversion(enum ms5805_measurement measurement);
+
+  /**
+  * \brief Reads the result of the last conversion, which has to be complete
+  * (see get_conversion_time).
+  *
+  * \param[out] uint32_t* : ADC value
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  */
+  enum ms5805_status read_adc(uint32_t *adc);
+
+  /**
+  * \brief Command starting a conversion at the current resolution.
+  *
+  * \param[in] ms5805_measurement : Temperature or pressure conversion
+  *
+  * \return uint8_t : Command value
+  */
+  uint8_t get_conversion_command(enum ms5805_measurement measurement);
+
+  /**
+  * \brief Duration of a conversion at the current resolution.
+  *
+  * \return uint32_t : Conversion time in ms
+  */
+  uint32_t get_conversion_time(void);
+
+  /**
+  * \brief Computes the compensated values from ADC values acquired with
+  * start_conversion() and read_adc().
+  *
+  * \param[in] uint32_t : Temperature ADC value
+  * \param[in] uint32_t : Pressure ADC value
+  * \param[out] float* : Celsius Degree temperature value
+  * \param[out] float* : mbar pressure value
+  *
+  * \return ms5805_status : status of MS5805
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  *       - ms5805_status_crc_error : CRC check error on on the PROM
+  * coefficients
+  */
+  enum ms5805_status compute_temperature_and_pressure(uint32_t adc_temperature,
+                                                      uint32_t adc_pressure,
+                                                      float *temperature,
+                                                      float *pressure);
+
+#ifdef MS5805_HAS_COROUTINES
+  /**
+  * \brief Measure from a coroutine : co_await suspends it during the
+  * conversions instead of waiting, letting the scheduler run other
+  * coroutines. Defined in ms5805_coroutine.h.
+  *
+  * \param[in] ms5805_scheduler& : Scheduler running the coroutine
+  * \param[out] ms5805_sample* : Compensated sample
+  *
+  * \return ms5805_measure_operation : Awaitable, whose result is the
+  * ms5805_status of the measurement
+  */
+  ms5805_measure_operation measure(ms5805_scheduler &scheduler,
+                                   struct ms5805_sample *sample);
+#endif
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+  /**
+  * \brief Copy the I2C instrumentation counters and latency histograms.
+  *
+  * \param[out] ms5805_instrumentation* : Snapshot of the counters
+  */
+  void get_instrumentation(struct ms5805_instrumentation *snapshot);
+
+  /**
+  * \brief Clear the I2C instrumentation counters and latency histograms.
+  */
+  void reset_instrumentation(void);
+#endif
+
 private:
+  friend class ms5805_measure_operation;
+  friend class ms5805_sampler;
+
+  enum ms5805_status bus_write(const uint8_t *data, uint8_t length);
+  enum ms5805_status bus_write_read(uint8_t cmd, uint8_t *buffer,
+                                    uint8_t size);
   enum ms5805_status write_command(uint8_t cmd);
   enum ms5805_status read_eeprom_coeff(uint8_t command, uint16_t *coeff);
   boolean crc_check(uint16_t *n_prom, uint8_t crc);
   enum ms5805_status conversion_and_read_adc(uint8_t cmd, uint32_t *adc);
   enum ms5805_status read_eeprom(void);
+  bool claim_bus(void);
+  void release_bus(void);
+  enum ms5805_status
+  begin_measurement(volatile enum ms5805_measurement_state *state,
+                    struct ms5805_sample *sample);
+  enum ms5805_status
+  advance_measurement(volatile enum ms5805_measurement_state *state,
+                      struct ms5805_sample *sample);
+  void complete_measurement(enum ms5805_status status);
+  void compensate_sample(struct ms5805_sample *sample);
+  enum ms5805_status process_sample(struct ms5805_sample *sample);
+  void publish_sample(const struct ms5805_sample *sample);
 
   uint16_t eeprom_coeff[MS5805_COEFFICIENT_COUNT + 1];
   bool coeff_read = false;
@@ -105,9 +549,41 @@ private:
   enum ms5805_status ms5805_read_eeprom(void);
   enum ms5805_status ms5805_conversion_and_read_adc(uint8_t, uint32_t *);
 
-  enum ms5805_resolution_osr ms5805_resolution_osr;
+  enum ms5805_resolution_osr ms5805_resolution_osr = ms5805_resolution_osr_256;
+  ms5805_clock *clock;
+  ms5805_bus *bus;
+  ms5805_sample_cell *sample_cell = NULL;
+  ms5805_dispatcher *dispatcher = NULL;
+  ms5805_stage *pipeline = NULL;
+  volatile bool busy = false;
+
+  ms5805_sample_callback sample_callback = NULL;
+  void *sample_callback_context = NULL;
+  volatile enum ms5805_measurement_state measurement_state =
+      ms5805_measurement_state_idle;
+  bool continuous = false;
+  uint32_t conversion_start;
+  struct ms5805_sample measurement;
+
+  // Written with the bus claimed, read from anywhere
+  ms5805_sample_cell cache;
+  uint32_t cache_ttl = 0; // In us
+
+  int32_t qnh = MS5805_STANDARD_PRESSURE;
+  struct ms5805_altitude_reference altitude_reference;
   uint32_t conversion_time[6] = {
       MS5805_CONVERSION_TIME_OSR_256,  MS5805_CONVERSION_TIME_OSR_512,
       MS5805_CONVERSION_TIME_OSR_1024, MS5805_CONVERSION_TIME_OSR_2048,
       MS5805_CONVERSION_TIME_OSR_4096, MS5805_CONVERSION_TIME_OSR_8192};
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+  void record_transfer(uint8_t written, uint8_t read,
+                       enum ms5805_status status);
+  void record_latency(enum ms5805_phase phase, uint32_t latency_us);
+  void record_bus_phases(const struct ms5805_bus_timing *timing);
+
+  struct ms5805_instrumentation instrumentation = {};
+#endif
 };
+
+#endif
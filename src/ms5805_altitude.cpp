@@ -0,0 +1,264 @@
+#include "ms5805_altitude.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define MS5805_ALTITUDE_TABLE_READ(i)                                          \
+  ((int32_t)pgm_read_dword(&ms5805_altitude_table[i]))
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define MS5805_ALTITUDE_TABLE_READ(i) ((int32_t)ms5805_altitude_table[i])
+#endif
+
+// Table step, 5.12 mbar, as a power of 2 of 0.01 mbar
+#define MS5805_ALTITUDE_TABLE_SHIFT 9
+#define MS5805_ALTITUDE_TABLE_SIZE 177
+
+// 44330.77 m in cm
+#define MS5805_ALTITUDE_SCALE_HEIGHT 4433077ULL
+
+// g(p) = (p / 1013.25 mbar)^0.190263 in Q2.30, from 300 mbar every 5.12 mbar
+static const uint32_t ms5805_altitude_table[MS5805_ALTITUDE_TABLE_SIZE]
+    PROGMEM = {
+    851780574, 854527521, 857237393, 859911291, 862550265,
+    865155317, 867727408, 870267455, 872776337, 875254896,
+    877703939, 880124239, 882516541, 884881558, 887219975,
+    889532453, 891819625, 894082103, 896320474, 898535305,
+    900727142, 902896512, 905043924, 907169867, 909274816,
+    911359229, 913423548, 915468200, 917493600, 919500149,
+    921488233, 923458229, 925410499, 927345398, 929263266,
+    931164434, 933049225, 934917951, 936770913, 938608407,
+    940430718, 942238123, 944030893, 945809289, 947573567,
+    949323974, 951060753, 952784137, 954494356, 956191633,
+    957876184, 959548220, 961207947, 962855567, 964491274,
+    966115260, 967727710, 969328807, 970918727, 972497643,
+    974065724, 975623134, 977170036, 978706585, 980232935,
+    981749237, 983255637, 984752279, 986239302, 987716844,
+    989185039, 990644017, 992093908, 993534837, 994966926,
+    996390296, 997805065, 999211347, 1000609257, 1001998904,
+    1003380397, 1004753842, 1006119343, 1007477002, 1008826919,
+    1010169192, 1011503917, 1012831189, 1014151099, 1015463738,
+    1016769195, 1018067558, 1019358912, 1020643340, 1021920927,
+    1023191751, 1024455894, 1025713432, 1026964443, 1028209001,
+    1029447181, 1030679056, 1031904696, 1033124171, 1034337552,
+    1035544904, 1036746295, 1037941790, 1039131454, 1040315349,
+    1041493537, 1042666081, 1043833039, 1044994472, 1046150437,
+    1047300991, 1048446190, 1049586091, 1050720747, 1051850212,
+    1052974539, 1054093780, 1055207986, 1056317208, 1057421494,
+    1058520894, 1059615456, 1060705226, 1061790253, 1062870581,
+    1063946256, 1065017322, 1066083824, 1067145804, 1068203306,
+    1069256370, 1070305039, 1071349354, 1072389354, 1073425079,
+    1074456568, 1075483861, 1076506994, 1077526005, 1078540931,
+    1079551809, 1080558675, 1081561563, 1082560509, 1083555548,
+    1084546713, 1085534037, 1086517555, 1087497298, 1088473299,
+    1089445590, 1090414201, 1091379165, 1092340511, 1093298270,
+    1094252471, 1095203144, 1096150318, 1097094022, 1098034283,
+    1098971131, 1099904591, 1100834692, 1101761461, 1102684924,
+    1103605107, 1104522036, 1105435737, 1106346236, 1107253556,
+    1108157723, 1109058761,
+};
+
+// Reference for 1013.25 mbar : g(p0) = 1
+static const struct ms5805_altitude_reference ms5805_standard_reference = {
+    1L << 30, (uint32_t)(MS5805_ALTITUDE_SCALE_HEIGHT << 8)};
+
+/**
+* \brief Read the three table points around a pressure : the first one, its
+* first and its second difference.
+*
+* \param[in] int32_t : Table index of the pressure, clamped to the table
+* \param[out] int32_t* : g at the index, in Q2.30
+* \param[out] int32_t* : First difference
+* \param[out] int32_t* : Second difference
+*/
+static void ms5805_altitude_segment(int32_t index, int32_t *g,
+                                    int32_t *difference,
+                                    int32_t *second_difference) {
+  int32_t g1, g2;
+
+  *g = MS5805_ALTITUDE_TABLE_READ(index);
+  g1 = MS5805_ALTITUDE_TABLE_READ(index + 1);
+  g2 = MS5805_ALTITUDE_TABLE_READ(index + 2);
+  *difference = g1 - *g;
+  // Entries are close to 2^30 : 2 * g1 would overflow, first differences
+  // do not
+  *second_difference = (g2 - g1) - *difference;
+}
+
+/**
+* \brief Compute the pressure factor g(p) = (p / 1013.25 mbar)^0.190263.
+*
+* \param[in] int32_t : Pressure in 0.01 mbar
+*
+* \return int32_t : Pressure factor in Q2.30
+*/
+int32_t ms5805_pressure_factor(int32_t pressure) {
+  int32_t offset, index, g, difference, second_difference;
+  int64_t interpolation;
+
+  if (pressure < MS5805_ALTITUDE_MIN_PRESSURE)
+    pressure = MS5805_ALTITUDE_MIN_PRESSURE;
+  if (pressure > MS5805_ALTITUDE_MAX_PRESSURE)
+    pressure = MS5805_ALTITUDE_MAX_PRESSURE;
+
+  // The last segment extends past its second point up to the end of the range
+  offset = pressure - MS5805_ALTITUDE_MIN_PRESSURE;
+  index = offset >> MS5805_ALTITUDE_TABLE_SHIFT;
+  if (index > MS5805_ALTITUDE_TABLE_SIZE - 3)
+    index = MS5805_ALTITUDE_TABLE_SIZE - 3;
+  offset -= index << MS5805_ALTITUDE_TABLE_SHIFT;
+
+  // Newton form, with t = offset / 512 :
+  // g = g0 + t * difference + t * (t - 1) / 2 * second_difference
+  ms5805_altitude_segment(index, &g, &difference, &second_difference);
+  interpolation =
+      ((int64_t)offset * difference << (MS5805_ALTITUDE_TABLE_SHIFT + 1)) +
+      (int64_t)(offset * (offset - (1L << MS5805_ALTITUDE_TABLE_SHIFT))) *
+          second_difference;
+
+  interpolation += 1L << (2 * MS5805_ALTITUDE_TABLE_SHIFT);
+
+  return g + (int32_t)(interpolation >> (2 * MS5805_ALTITUDE_TABLE_SHIFT + 1));
+}
+
+/**
+* \brief Set the pressure factor of an altitude reference, and the scale
+* derived from it.
+*
+* \param[out] ms5805_altitude_reference* : Reference to prepare
+* \param[in] int32_t : g(p0) in Q2.30
+*/
+static void
+ms5805_set_reference_factor(struct ms5805_altitude_reference *reference,
+                            int32_t factor) {
+  reference->factor = factor;
+  reference->scale = (uint32_t)(((MS5805_ALTITUDE_SCALE_HEIGHT << 38) +
+                                 factor / 2) /
+                                factor);
+}
+
+/**
+* \brief Prepare an altitude reference from its pressure.
+*
+* \param[out] ms5805_altitude_reference* : Reference to prepare
+* \param[in] int32_t : Reference pressure in 0.01 mbar, at altitude 0
+*/
+void ms5805_set_altitude_reference(struct ms5805_altitude_reference *reference,
+                                   int32_t pressure) {
+  ms5805_set_reference_factor(reference, ms5805_pressure_factor(pressure));
+}
+
+/**
+* \brief Prepare an altitude reference from a pressure measured at a known
+* altitude.
+*
+* \param[out] ms5805_altitude_reference* : Reference to prepare
+* \param[in] int32_t : Measured pressure in 0.01 mbar
+* \param[in] int32_t : Altitude of the measurement in cm
+*/
+void ms5805_calibrate_altitude_reference(
+    struct ms5805_altitude_reference *reference, int32_t pressure,
+    int32_t altitude) {
+  int64_t height = (int64_t)MS5805_ALTITUDE_SCALE_HEIGHT - altitude;
+
+  // h = H * (1 - g(p) / g(p0)) gives g(p0) = g(p) * H / (H - h)
+  ms5805_set_reference_factor(
+      reference,
+      (int32_t)(((int64_t)ms5805_pressure_factor(pressure) *
+                     (int64_t)MS5805_ALTITUDE_SCALE_HEIGHT +
+                 height / 2) /
+                height));
+}
+
+/**
+* \brief Compute the pressure of an altitude reference, for instance after
+* ms5805_calibrate_altitude_reference().
+*
+* \param[in] ms5805_altitude_reference* : Reference
+*
+* \return int32_t : Reference pressure in 0.01 mbar, at altitude 0
+*/
+int32_t
+ms5805_reference_pressure(const struct ms5805_altitude_reference *reference) {
+  int32_t low = MS5805_ALTITUDE_MIN_PRESSURE;
+  int32_t high = MS5805_ALTITUDE_MAX_PRESSURE;
+  int32_t middle;
+
+  // g is increasing : search the first pressure whose factor reaches the
+  // reference one, then keep the closest of it and the previous pressure
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (ms5805_pressure_factor(middle) < reference->factor)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if (low > MS5805_ALTITUDE_MIN_PRESSURE &&
+      reference->factor - ms5805_pressure_factor(low - 1) <
+          ms5805_pressure_factor(low) - reference->factor)
+    low--;
+
+  return low;
+}
+
+/**
+* \brief Compute the altitude of a pressure, with integer arithmetic only.
+*
+* \param[in] int32_t : Pressure in 0.01 mbar
+* \param[in] ms5805_altitude_reference* : Reference, NULL for 1013.25 mbar
+*
+* \return int32_t : Altitude in cm
+*/
+int32_t ms5805_altitude_cm(int32_t pressure,
+                           const struct ms5805_altitude_reference *reference) {
+  int64_t altitude;
+
+  if (reference == NULL)
+    reference = &ms5805_standard_reference;
+
+  // h = 44330.77 m * (g(p0) - g(p)) / g(p0)
+  altitude = (int64_t)(reference->factor - ms5805_pressure_factor(pressure)) *
+             reference->scale;
+
+  return (int32_t)((altitude + (1LL << 37)) >> 38);
+}
+
+/**
+* \brief Compute the altitude of a pressure.
+*
+* \param[in] float : Pressure in mbar
+* \param[in] ms5805_altitude_reference* : Reference, NULL for 1013.25 mbar
+*
+* \return float : Altitude in m
+*/
+float ms5805_altitude(float pressure,
+                      const struct ms5805_altitude_reference *reference) {
+  const float step = (float)(1L << MS5805_ALTITUDE_TABLE_SHIFT);
+  const float end =
+      (MS5805_ALTITUDE_MAX_PRESSURE - MS5805_ALTITUDE_MIN_PRESSURE) / step;
+  float position, t, difference;
+  int32_t index, g, first_difference, second_difference;
+
+  if (reference == NULL)
+    reference = &ms5805_standard_reference;
+
+  position = (pressure * 100 - MS5805_ALTITUDE_MIN_PRESSURE) / step;
+  if (position < 0)
+    position = 0;
+  if (position > end)
+    position = end;
+  index = (int32_t)position;
+  if (index > MS5805_ALTITUDE_TABLE_SIZE - 3)
+    index = MS5805_ALTITUDE_TABLE_SIZE - 3;
+  t = position - index;
+
+  // g(p0) - g(p) is taken from the table in integer, so that the float
+  // subtraction only involves the small interpolation terms
+  ms5805_altitude_segment(index, &g, &first_difference, &second_difference);
+  difference = (float)(reference->factor - g) -
+               t * (first_difference + (t - 1) * 0.5f * second_difference);
+
+  // scale is in 2^-8 cm, the difference in Q2.30
+  return difference * reference->scale * (1.0f / 27487790694400.0f);
+}
@@ -0,0 +1,104 @@
+#ifndef MS5805_ALTITUDE_H
+#define MS5805_ALTITUDE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Barometric altitude without powf.
+ *
+ * The standard atmosphere gives h = 44330.77 m * (1 - (p / p0)^0.190263). The
+ * factor g(p) = (p / 1013.25 mbar)^0.190263 is tabulated every 5.12 mbar over
+ * the range of the sensor, from 300 to 1200 mbar, and interpolated with a
+ * parabola through three table points. Then h = 44330.77 m * (1 - g(p) /
+ * g(p0)), where everything depending on the reference pressure p0 is computed
+ * once, in a ms5805_altitude_reference.
+ *
+ * Interpolation error is under 4 mm over the whole range, well below the
+ * 0.01 mbar resolution of the compensated pressure (8 cm at sea level). The
+ * integer function rounds to the nearest centimetre, so it stays within 1 cm
+ * of the formula. Pressures outside of the range are clamped.
+ */
+
+// Pressure range of the altitude table, in 0.01 mbar
+#define MS5805_ALTITUDE_MIN_PRESSURE 30000L
+#define MS5805_ALTITUDE_MAX_PRESSURE 120000L
+
+// Standard atmosphere sea-level pressure, in 0.01 mbar
+#define MS5805_STANDARD_PRESSURE 101325L
+
+/**
+ * \brief Altitude reference, prepared by ms5805_set_altitude_reference().
+ */
+struct ms5805_altitude_reference {
+  // g(p0), in Q2.30
+  int32_t factor;
+  // 44330.77 m / g(p0), in 2^-8 cm
+  uint32_t scale;
+};
+
+/**
+* \brief Compute the pressure factor g(p) = (p / 1013.25 mbar)^0.190263.
+*
+* \param[in] int32_t : Pressure in 0.01 mbar
+*
+* \return int32_t : Pressure factor in Q2.30
+*/
+int32_t ms5805_pressure_factor(int32_t pressure);
+
+/**
+* \brief Prepare an altitude reference from its pressure.
+*
+* \param[out] ms5805_altitude_reference* : Reference to prepare
+* \param[in] int32_t : Reference pressure in 0.01 mbar, at altitude 0
+*/
+void ms5805_set_altitude_reference(struct ms5805_altitude_reference *reference,
+                                   int32_t pressure);
+
+/**
+* \brief Prepare an altitude reference from a pressure measured at a known
+* altitude.
+*
+* \param[out] ms5805_altitude_reference* : Reference to prepare
+* \param[in] int32_t : Measured pressure in 0.01 mbar
+* \param[in] int32_t : Altitude of the measurement in cm
+*/
+void ms5805_calibrate_altitude_reference(
+    struct ms5805_altitude_reference *reference, int32_t pressure,
+    int32_t altitude);
+
+/**
+* \brief Compute the pressure of an altitude reference, for instance after
+* ms5805_calibrate_altitude_reference().
+*
+* \param[in] ms5805_altitude_reference* : Reference
+*
+* \return int32_t : Reference pressure in 0.01 mbar, at altitude 0
+*/
+int32_t
+ms5805_reference_pressure(const struct ms5805_altitude_reference *reference);
+
+/**
+* \brief Compute the altitude of a pressure, with integer arithmetic only.
+*
+* \param[in] int32_t : Pressure in 0.01 mbar
+* \param[in] ms5805_altitude_reference* : Reference, NULL for 1013.25 mbar
+*
+* \return int32_t : Altitude in cm
+*/
+int32_t ms5805_altitude_cm(
+    int32_t pressure,
+    const struct ms5805_altitude_reference *reference = NULL);
+
+/**
+* \brief Compute the altitude of a pressure.
+*
+* \param[in] float : Pressure in mbar
+* \param[in] ms5805_altitude_reference* : Reference, NULL for 1013.25 mbar
+*
+* \return float : Altitude in m
+*/
+float ms5805_altitude(float pressure,
+                      const struct ms5805_altitude_reference *reference = NULL);
+
+#endif
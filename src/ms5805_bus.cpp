@@ -0,0 +1,122 @@
+#include "ms5805_bus.h"
+
+/**
+* \brief Class destructor
+*/
+ms5805_bus::~ms5805_bus() {}
+
+/**
+* \brief Initialize the bus. Called by ms5805::begin.
+*/
+void ms5805_bus::begin(void) {}
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+/**
+* \brief Set the time source of the phase timing. Called by the driver before
+* every transfer.
+*
+* \param[in] ms5805_clock* : Clock to use, NULL disables the timing
+*/
+void ms5805_bus::set_clock(ms5805_clock *clock) { this->clock = clock; }
+
+/**
+* \brief Durations of the phases of the last transfer.
+*/
+const struct ms5805_bus_timing *ms5805_bus::get_timing(void) {
+  return &timing;
+}
+
+/**
+* \brief Current time of the phase timing.
+*
+* \return uint32_t : Time in us, 0 without clock
+*/
+uint32_t ms5805_bus::timestamp(void) { return clock ? clock->micros() : 0; }
+#endif
+
+#if defined(ARDUINO)
+/**
+* \brief Class constructor
+*
+* \param[in] TwoWire& : Wire interface to use
+*/
+ms5805_wire_bus::ms5805_wire_bus(TwoWire &wire) : wire(wire) {}
+
+/**
+* \brief Initialize the Wire interface.
+*/
+void ms5805_wire_bus::begin(void) { wire.begin(); }
+
+/**
+* \brief Write bytes to a device.
+*
+* \param[in] uint8_t : 7-bits device address
+* \param[in] uint8_t* : Bytes to write
+* \param[in] uint8_t : Number of bytes, 0 only checks the acknowledge
+*
+* \return ms5805_status : status of the transfer
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_wire_bus::write(uint8_t address, const uint8_t *data,
+                                          uint8_t length) {
+  uint8_t i2c_status;
+
+  MS5805_BUS_TIMING_CLEAR();
+  MS5805_BUS_TIMING_START(start);
+  wire.beginTransmission(address);
+  if (length)
+    wire.write(data, length);
+  i2c_status = wire.endTransmission();
+  MS5805_BUS_TIMING_PHASE(write, start);
+
+  if (i2c_status == ms5805_STATUS_ERR_OVERFLOW ||
+      i2c_status == ms5805_STATUS_ERR_ADDRESS_NACK ||
+      i2c_status == ms5805_STATUS_ERR_DATA_NACK)
+    return ms5805_status_no_i2c_acknowledge;
+  if (i2c_status != ms5805_STATUS_OK)
+    return ms5805_status_i2c_transfer_error;
+
+  return ms5805_status_ok;
+}
+
+/**
+* \brief Write bytes to a device then read its answer.
+*
+* \param[in] uint8_t : 7-bits device address
+* \param[in] uint8_t* : Bytes to write
+* \param[in] uint8_t : Number of bytes to write
+* \param[out] uint8_t* : Bytes read
+* \param[in] uint8_t : Number of bytes to read
+*
+* \return ms5805_status : status of the transfer
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_wire_bus::write_read(uint8_t address,
+                                               const uint8_t *data,
+                                               uint8_t length, uint8_t *buffer,
+                                               uint8_t size) {
+  enum ms5805_status status;
+  uint8_t received;
+  uint8_t i;
+
+  status = write(address, data, length);
+  if (status != ms5805_status_ok)
+    return status;
+
+  // The write timed itself, the read starts at its end
+  MS5805_BUS_TIMING_START(read_start);
+  received = wire.requestFrom(address, size);
+  for (i = 0; i < size; i++)
+    buffer[i] = wire.read();
+  MS5805_BUS_TIMING_PHASE(read, read_start);
+
+  if (received != size)
+    return ms5805_status_i2c_transfer_error;
+
+  return ms5805_status_ok;
+}
+#endif
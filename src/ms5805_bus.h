@@ -0,0 +1,131 @@
+#ifndef MS5805_BUS_H
+#define MS5805_BUS_H
+
+#include "ms5805.h"
+
+#if defined(ARDUINO)
+#include <Wire.h>
+#endif
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+/**
+ * \brief Durations of the phases of the last transfer, measured by the bus.
+ */
+struct ms5805_bus_timing {
+  bool write_timed; // false if the write was issued along with the read
+  bool read_timed;
+  uint32_t write_us; // Write, up to the end of transmission
+  uint32_t read_us;  // Read of the answer
+};
+
+// Phase timing hooks of the backends
+#define MS5805_BUS_TIMING_CLEAR()                                              \
+  timing.write_timed = false;                                                  \
+  timing.read_timed = false
+#define MS5805_BUS_TIMING_START(start) uint32_t start = timestamp()
+#define MS5805_BUS_TIMING_PHASE(phase, start)                                  \
+  timing.phase##_timed = true;                                                 \
+  timing.phase##_us = timestamp() - (start)
+#else
+#define MS5805_BUS_TIMING_CLEAR()
+#define MS5805_BUS_TIMING_START(start)
+#define MS5805_BUS_TIMING_PHASE(phase, start)
+#endif
+
+/**
+ * \brief I2C transport used by the driver.
+ *
+ * With MS5805_ENABLE_INSTRUMENTATION, backends time the write and the read of
+ * every transfer themselves, where the boundary between both is known.
+ */
+class ms5805_bus {
+
+public:
+  virtual ~ms5805_bus();
+
+  /**
+   * \brief Initialize the bus. Called by ms5805::begin.
+   */
+  virtual void begin(void);
+
+  /**
+  * \brief Write bytes to a device.
+  *
+  * \param[in] uint8_t : 7-bits device address
+  * \param[in] uint8_t* : Bytes to write
+  * \param[in] uint8_t : Number of bytes, 0 only checks the acknowledge
+  *
+  * \return ms5805_status : status of the transfer
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  */
+  virtual enum ms5805_status write(uint8_t address, const uint8_t *data,
+                                   uint8_t length) = 0;
+
+  /**
+  * \brief Write bytes to a device then read its answer.
+  *
+  * \param[in] uint8_t : 7-bits device address
+  * \param[in] uint8_t* : Bytes to write
+  * \param[in] uint8_t : Number of bytes to write
+  * \param[out] uint8_t* : Bytes read
+  * \param[in] uint8_t : Number of bytes to read
+  *
+  * \return ms5805_status : status of the transfer
+  *       - ms5805_status_ok : I2C transfer completed successfully
+  *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+  *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+  */
+  virtual enum ms5805_status write_read(uint8_t address, const uint8_t *data,
+                                        uint8_t length, uint8_t *buffer,
+                                        uint8_t size) = 0;
+
+#ifdef MS5805_ENABLE_INSTRUMENTATION
+  /**
+   * \brief Set the time source of the phase timing. Called by the driver
+   * before every transfer.
+   *
+   * \param[in] ms5805_clock* : Clock to use, NULL disables the timing
+   */
+  void set_clock(ms5805_clock *clock);
+
+  /**
+   * \brief Durations of the phases of the last transfer.
+   */
+  const struct ms5805_bus_timing *get_timing(void);
+
+protected:
+  uint32_t timestamp(void);
+
+  ms5805_clock *clock = NULL;
+  struct ms5805_bus_timing timing = {};
+#endif
+};
+
+#if defined(ARDUINO)
+/**
+ * \brief Bus implemented with the Arduino Wire library.
+ */
+class ms5805_wire_bus : public ms5805_bus {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] TwoWire& : Wire interface to use
+   */
+  ms5805_wire_bus(TwoWire &wire);
+
+  void begin(void);
+  enum ms5805_status write(uint8_t address, const uint8_t *data,
+                           uint8_t length);
+  enum ms5805_status write_read(uint8_t address, const uint8_t *data,
+                                uint8_t length, uint8_t *buffer, uint8_t size);
+
+private:
+  TwoWire &wire;
+};
+#endif
+
+#endif
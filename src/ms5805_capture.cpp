@@ -0,0 +1,191 @@
+#include "ms5805_capture.h"
+
+static void put_be(uint8_t *buffer, uint32_t value, uint8_t size) {
+  while (size--) {
+    buffer[size] = (uint8_t)value;
+    value >>= 8;
+  }
+}
+
+static uint32_t get_be(const uint8_t *buffer, uint8_t size) {
+  uint32_t value = 0;
+  uint8_t i;
+
+  for (i = 0; i < size; i++)
+    value = (value << 8) | buffer[i];
+
+  return value;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_writer& : Destination of the capture
+*/
+ms5805_capture_encoder::ms5805_capture_encoder(ms5805_writer &writer)
+    : writer(writer), flags(0), last_timestamp(0) {}
+
+/**
+* \brief Write the capture header. Has to be called once, first.
+*
+* \param[in] uint16_t* : PROM coefficients, see ms5805::read_coefficients
+* \param[in] uint8_t : Resolution used for the conversions
+* \param[in] uint8_t : Header flags
+* \param[in] uint32_t : Capture start time in ms
+*
+* \return bool : true if the header was completely written
+*/
+bool ms5805_capture_encoder::write_header(const uint16_t *coeff, uint8_t osr,
+                                          uint8_t flags, uint32_t start_ms) {
+  uint8_t header[MS5805_CAPTURE_HEADER_SIZE];
+  uint8_t i;
+
+  this->flags = flags;
+  last_timestamp = start_ms;
+
+  header[0] = 'M';
+  header[1] = '5';
+  header[2] = 'R';
+  header[3] = MS5805_CAPTURE_VERSION;
+  header[4] = flags;
+  header[5] = osr;
+  header[6] = 0;
+  header[7] = 0;
+  put_be(header + 8, start_ms, 4);
+  for (i = 0; i < MS5805_CAPTURE_PROM_COUNT; i++)
+    put_be(header + 12 + i * 2, coeff[i], 2);
+
+  return writer.write(header, sizeof(header)) == sizeof(header);
+}
+
+/**
+* \brief Write a record.
+*
+* \param[in] uint32_t : Sample time in ms
+* \param[in] uint32_t : Temperature ADC value (D2)
+* \param[in] uint32_t : Pressure ADC value (D1)
+*
+* \return bool : true if the record was completely written
+*/
+bool ms5805_capture_encoder::write_sample(uint32_t timestamp_ms,
+                                          uint32_t adc_temperature,
+                                          uint32_t adc_pressure) {
+  uint8_t record[MS5805_CAPTURE_MAX_RECORD_SIZE];
+  uint8_t size = 0;
+  uint32_t delta;
+
+  if (flags & MS5805_CAPTURE_FLAG_TIMESTAMPS) {
+    delta = timestamp_ms - last_timestamp;
+    if (delta < MS5805_CAPTURE_DELTA_ESCAPE) {
+      record[size++] = (uint8_t)delta;
+    } else {
+      record[size++] = MS5805_CAPTURE_DELTA_ESCAPE;
+      put_be(record + size, delta, 4);
+      size += 4;
+    }
+  }
+  put_be(record + size, adc_temperature, 3);
+  put_be(record + size + 3, adc_pressure, 3);
+  size += 6;
+
+  if (writer.write(record, size) != size)
+    return false;
+
+  last_timestamp = timestamp_ms;
+
+  return true;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint8_t* : Capture content
+* \param[in] size_t : Capture length
+*/
+ms5805_capture_decoder::ms5805_capture_decoder(const uint8_t *data,
+                                               size_t length)
+    : data(data), length(length), offset(0), flags(0), timestamp(0) {}
+
+/**
+* \brief Parse the capture header. Has to be called once, first.
+*
+* \param[out] ms5805_capture_header* : Header content
+*
+* \return bool : false if the header is missing or of unknown version
+*/
+bool ms5805_capture_decoder::read_header(struct ms5805_capture_header *header) {
+  uint8_t i;
+
+  if (length < MS5805_CAPTURE_HEADER_SIZE || data[0] != 'M' ||
+      data[1] != '5' || data[2] != 'R' || data[3] != MS5805_CAPTURE_VERSION)
+    return false;
+
+  header->version = data[3];
+  header->flags = data[4];
+  header->osr = data[5];
+  header->start_ms = get_be(data + 8, 4);
+  for (i = 0; i < MS5805_CAPTURE_PROM_COUNT; i++)
+    header->coeff[i] = (uint16_t)get_be(data + 12 + i * 2, 2);
+
+  flags = header->flags;
+  timestamp = header->start_ms;
+  offset = MS5805_CAPTURE_HEADER_SIZE;
+
+  return true;
+}
+
+/**
+* \brief Parse the next record.
+*
+* \param[out] ms5805_capture_record* : Record content, with absolute time
+*
+* \return bool : false at the end of the capture or on a truncated record
+*/
+bool ms5805_capture_decoder::read_record(struct ms5805_capture_record *record) {
+  size_t next = offset;
+  uint32_t delta = 0;
+
+  if (flags & MS5805_CAPTURE_FLAG_TIMESTAMPS) {
+    if (next >= length)
+      return false;
+    delta = data[next++];
+    if (delta == MS5805_CAPTURE_DELTA_ESCAPE) {
+      if (length - next < 4)
+        return false;
+      delta = get_be(data + next, 4);
+      next += 4;
+    }
+  }
+  if (next > length || length - next < 6)
+    return false;
+
+  timestamp += delta;
+  record->timestamp_ms = timestamp;
+  record->adc_temperature = get_be(data + next, 3);
+  record->adc_pressure = get_be(data + next + 3, 3);
+  offset = next + 6;
+
+  return true;
+}
+
+/**
+* \brief Move to a record, to decode from there. The header has to be read
+* first.
+*
+* \param[in] size_t : Offset of the record, as returned by position()
+* \param[in] uint32_t : Time of the record preceding this offset in ms
+*/
+void ms5805_capture_decoder::seek(size_t offset, uint32_t timestamp_ms) {
+  this->offset = offset;
+  timestamp = timestamp_ms;
+}
+
+/**
+* \brief Offset of the next record in the capture.
+*/
+size_t ms5805_capture_decoder::position(void) { return offset; }
+
+/**
+* \brief Time of the last record read in ms.
+*/
+uint32_t ms5805_capture_decoder::time(void) { return timestamp; }
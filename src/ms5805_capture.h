@@ -0,0 +1,147 @@
+#ifndef MS5805_CAPTURE_H
+#define MS5805_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ms5805_writer.h"
+
+/*
+ * Raw capture format, all values big-endian :
+ *
+ * Header (26 bytes)
+ *   'M' '5' 'R' version | flags | osr | 2 reserved bytes | start time (ms, 4)
+ *   | 7 PROM coefficients (2 bytes each)
+ *
+ * Records (7 bytes, 6 without MS5805_CAPTURE_FLAG_TIMESTAMPS)
+ *   time delta (ms, 1) | D2 temperature ADC (3) | D1 pressure ADC (3)
+ *   A delta of MS5805_CAPTURE_DELTA_ESCAPE is followed by the full 4 bytes
+ *   delta, for gaps of MS5805_CAPTURE_DELTA_ESCAPE ms or more.
+ */
+#define MS5805_CAPTURE_VERSION 1
+#define MS5805_CAPTURE_HEADER_SIZE 26
+#define MS5805_CAPTURE_PROM_COUNT 7
+#define MS5805_CAPTURE_DELTA_ESCAPE 0xFF
+#define MS5805_CAPTURE_MAX_RECORD_SIZE 11
+
+// Header flags
+#define MS5805_CAPTURE_FLAG_TIMESTAMPS 0x01
+
+struct ms5805_capture_header {
+  uint8_t version;
+  uint8_t flags;
+  uint8_t osr;
+  uint32_t start_ms;
+  uint16_t coeff[MS5805_CAPTURE_PROM_COUNT];
+};
+
+struct ms5805_capture_record {
+  uint32_t timestamp_ms;
+  uint32_t adc_temperature;
+  uint32_t adc_pressure;
+};
+
+/**
+ * \brief Streams raw ADC values in the compact capture format.
+ */
+class ms5805_capture_encoder {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_writer& : Destination of the capture
+   */
+  ms5805_capture_encoder(ms5805_writer &writer);
+
+  /**
+   * \brief Write the capture header. Has to be called once, first.
+   *
+   * \param[in] uint16_t* : PROM coefficients, see ms5805::read_coefficients
+   * \param[in] uint8_t : Resolution used for the conversions
+   * \param[in] uint8_t : Header flags
+   * \param[in] uint32_t : Capture start time in ms
+   *
+   * \return bool : true if the header was completely written
+   */
+  bool write_header(const uint16_t *coeff, uint8_t osr, uint8_t flags,
+                    uint32_t start_ms);
+
+  /**
+   * \brief Write a record.
+   *
+   * \param[in] uint32_t : Sample time in ms
+   * \param[in] uint32_t : Temperature ADC value (D2)
+   * \param[in] uint32_t : Pressure ADC value (D1)
+   *
+   * \return bool : true if the record was completely written
+   */
+  bool write_sample(uint32_t timestamp_ms, uint32_t adc_temperature,
+                    uint32_t adc_pressure);
+
+private:
+  ms5805_writer &writer;
+  uint8_t flags;
+  uint32_t last_timestamp;
+};
+
+/**
+ * \brief Parses a capture held in memory.
+ */
+class ms5805_capture_decoder {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint8_t* : Capture content
+   * \param[in] size_t : Capture length
+   */
+  ms5805_capture_decoder(const uint8_t *data, size_t length);
+
+  /**
+   * \brief Parse the capture header. Has to be called once, first.
+   *
+   * \param[out] ms5805_capture_header* : Header content
+   *
+   * \return bool : false if the header is missing or of unknown version
+   */
+  bool read_header(struct ms5805_capture_header *header);
+
+  /**
+   * \brief Parse the next record.
+   *
+   * \param[out] ms5805_capture_record* : Record content, with absolute time
+   *
+   * \return bool : false at the end of the capture or on a truncated record
+   */
+  bool read_record(struct ms5805_capture_record *record);
+
+  /**
+   * \brief Move to a record, to decode from there. The header has to be
+   * read first.
+   *
+   * \param[in] size_t : Offset of the record, as returned by position()
+   * \param[in] uint32_t : Time of the record preceding this offset in ms
+   */
+  void seek(size_t offset, uint32_t timestamp_ms);
+
+  /**
+   * \brief Offset of the next record in the capture.
+   */
+  size_t position(void);
+
+  /**
+   * \brief Time of the last record read in ms.
+   */
+  uint32_t time(void);
+
+private:
+  const uint8_t *data;
+  size_t length;
+  size_t offset;
+  uint8_t flags;
+  uint32_t timestamp;
+};
+
+#endif
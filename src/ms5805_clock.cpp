@@ -0,0 +1,108 @@
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#elif defined(ARDUINO)
+#include "WProgram.h"
+#else
+#include <time.h>
+#endif
+
+#include "ms5805_clock.h"
+
+#if defined(ARDUINO)
+/**
+* \brief Wait for the given duration.
+*
+* \param[in] uint32_t : Duration in ms
+*/
+void ms5805_system_clock::delay(uint32_t ms) { ::delay(ms); }
+
+/**
+* \brief Current time in ms, wrapping around on 32-bits.
+*/
+uint32_t ms5805_system_clock::millis(void) { return ::millis(); }
+
+/**
+* \brief Current time in us, wrapping around on 32-bits.
+*/
+uint32_t ms5805_system_clock::micros(void) { return ::micros(); }
+#else
+static uint64_t monotonic_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+* \brief Wait for the given duration.
+*
+* \param[in] uint32_t : Duration in ms
+*/
+void ms5805_system_clock::delay(uint32_t ms) {
+  struct timespec ts;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (long)(ms % 1000) * 1000000;
+  // Resume the sleep when interrupted by a signal
+  while (nanosleep(&ts, &ts) != 0) {
+  }
+}
+
+/**
+* \brief Current time in ms, wrapping around on 32-bits.
+*/
+uint32_t ms5805_system_clock::millis(void) {
+  return (uint32_t)(monotonic_us() / 1000);
+}
+
+/**
+* \brief Current time in us, wrapping around on 32-bits.
+*/
+uint32_t ms5805_system_clock::micros(void) { return (uint32_t)monotonic_us(); }
+#endif
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint64_t : Initial time in us
+*/
+ms5805_virtual_clock::ms5805_virtual_clock(uint64_t start_us)
+    : now_us(start_us) {}
+
+/**
+* \brief Advance the simulated time by the given duration, without waiting.
+*
+* \param[in] uint32_t : Duration in ms
+*/
+void ms5805_virtual_clock::delay(uint32_t ms) { now_us += (uint64_t)ms * 1000; }
+
+/**
+* \brief Simulated time in ms, wrapping around on 32-bits.
+*/
+uint32_t ms5805_virtual_clock::millis(void) {
+  return (uint32_t)(now_us / 1000);
+}
+
+/**
+* \brief Simulated time in us, wrapping around on 32-bits.
+*/
+uint32_t ms5805_virtual_clock::micros(void) { return (uint32_t)now_us; }
+
+/**
+* \brief Move the time forward.
+*
+* \param[in] uint64_t : Duration in us
+*/
+void ms5805_virtual_clock::advance_us(uint64_t us) { now_us += us; }
+
+/**
+* \brief Set the current time.
+*
+* \param[in] uint64_t : Time in us
+*/
+void ms5805_virtual_clock::set_time_us(uint64_t us) { now_us = us; }
+
+/**
+* \brief Current time in us, without wrap around.
+*/
+uint64_t ms5805_virtual_clock::time_us(void) { return now_us; }
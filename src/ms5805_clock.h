@@ -0,0 +1,86 @@
+#ifndef MS5805_CLOCK_H
+#define MS5805_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * \brief Time source used by the driver for delays and timestamps.
+ *
+ * The driver never calls delay(), millis() or micros() directly so that host
+ * simulations can supply their own notion of time.
+ */
+class ms5805_clock {
+
+public:
+  /**
+   * \brief Wait for the given duration.
+   *
+   * \param[in] uint32_t : Duration in ms
+   */
+  virtual void delay(uint32_t ms) = 0;
+
+  /**
+   * \brief Current time in ms, wrapping around on 32-bits.
+   */
+  virtual uint32_t millis(void) = 0;
+
+  /**
+   * \brief Current time in us, wrapping around on 32-bits.
+   */
+  virtual uint32_t micros(void) = 0;
+};
+
+/**
+ * \brief Platform clock : Arduino timing functions, or the monotonic clock of
+ * the operating system on hosts.
+ */
+class ms5805_system_clock : public ms5805_clock {
+
+public:
+  void delay(uint32_t ms);
+  uint32_t millis(void);
+  uint32_t micros(void);
+};
+
+/**
+ * \brief Simulated clock. Delays advance the time instantly, so that
+ * long-duration simulations run as fast as the host allows.
+ */
+class ms5805_virtual_clock : public ms5805_clock {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint64_t : Initial time in us
+   */
+  ms5805_virtual_clock(uint64_t start_us = 0);
+
+  void delay(uint32_t ms);
+  uint32_t millis(void);
+  uint32_t micros(void);
+
+  /**
+   * \brief Move the time forward.
+   *
+   * \param[in] uint64_t : Duration in us
+   */
+  void advance_us(uint64_t us);
+
+  /**
+   * \brief Set the current time.
+   *
+   * \param[in] uint64_t : Time in us
+   */
+  void set_time_us(uint64_t us);
+
+  /**
+   * \brief Current time in us, without wrap around.
+   */
+  uint64_t time_us(void);
+
+private:
+  uint64_t now_us;
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include <string.h>
+
+#include "ms5805_codec.h"
+
+// Largest encoding of a sample : three 32-bits varints
+#define MS5805_CODEC_MAX_SAMPLE_SIZE 15
+// Largest block header : marker and two 16-bits varints
+#define MS5805_CODEC_MAX_BLOCK_HEADER_SIZE 7
+
+static uint8_t put_varint(uint8_t *buffer, uint32_t value) {
+  uint8_t size = 0;
+
+  while (value >= 0x80) {
+    buffer[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = (uint8_t)value;
+
+  return size;
+}
+
+static bool get_varint(const uint8_t *data, size_t length, size_t *offset,
+                       uint32_t *value) {
+  uint32_t result = 0;
+  uint8_t shift;
+  uint8_t byte;
+
+  for (shift = 0; shift < 35; shift += 7) {
+    if (*offset >= length)
+      return false;
+    byte = data[(*offset)++];
+    result |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static uint32_t zigzag_encode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (value < 0 ? 0xFFFFFFFFUL : 0);
+}
+
+static int32_t zigzag_decode(uint32_t value) {
+  return (int32_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_writer& : Destination of the log
+* \param[in] uint8_t : Maximum number of samples between two keyframes
+*/
+ms5805_codec_encoder::ms5805_codec_encoder(ms5805_writer &writer,
+                                           uint8_t keyframe_interval)
+    : writer(writer), keyframe_interval(keyframe_interval), used(0), count(0),
+      last() {}
+
+/**
+* \brief Write the log header. Has to be called once, first.
+*
+* \param[in] uint8_t : Kind of values, MS5805_CODEC_KIND_RAW or
+* MS5805_CODEC_KIND_COMPENSATED
+* \param[in] uint16_t* : PROM coefficients for raw logs, may be NULL
+* \param[in] uint8_t : Resolution used for the conversions
+*
+* \return bool : true if the header was completely written
+*/
+bool ms5805_codec_encoder::write_header(uint8_t kind, const uint16_t *coeff,
+                                        uint8_t osr) {
+  uint8_t header[MS5805_CODEC_HEADER_SIZE];
+  uint8_t i;
+
+  memset(header, 0, sizeof(header));
+  header[0] = 'M';
+  header[1] = '5';
+  header[2] = 'Z';
+  header[3] = MS5805_CODEC_VERSION;
+  header[4] = kind;
+  header[5] = osr;
+  if (coeff) {
+    for (i = 0; i < MS5805_CODEC_PROM_COUNT; i++) {
+      header[8 + i * 2] = coeff[i] >> 8;
+      header[9 + i * 2] = coeff[i] & 0xFF;
+    }
+  }
+
+  return writer.write(header, sizeof(header)) == sizeof(header);
+}
+
+/**
+* \brief Add a sample to the log.
+*
+* \param[in] uint32_t : Sample time
+* \param[in] int32_t : Temperature value
+* \param[in] int32_t : Pressure value
+*
+* \return bool : false if a completed block could not be written
+*/
+bool ms5805_codec_encoder::write_sample(uint32_t timestamp, int32_t temperature,
+                                        int32_t pressure) {
+  // Start a new block when the keyframe interval is reached or when the
+  // sample may not fit in the current one
+  if (count >= keyframe_interval ||
+      used + MS5805_CODEC_MAX_SAMPLE_SIZE > MS5805_CODEC_BLOCK_SIZE) {
+    if (!flush())
+      return false;
+  }
+
+  if (count == 0) {
+    used += put_varint(block + used, timestamp);
+    used += put_varint(block + used, zigzag_encode(temperature));
+    used += put_varint(block + used, zigzag_encode(pressure));
+  } else {
+    used += put_varint(block + used, timestamp - last.timestamp);
+    used += put_varint(
+        block + used,
+        zigzag_encode((int32_t)((uint32_t)temperature - last.temperature)));
+    used += put_varint(
+        block + used,
+        zigzag_encode((int32_t)((uint32_t)pressure - last.pressure)));
+  }
+  count++;
+
+  last.timestamp = timestamp;
+  last.temperature = temperature;
+  last.pressure = pressure;
+
+  return true;
+}
+
+/**
+* \brief Write the pending block. Has to be called before closing the log.
+*
+* \return bool : true if the block was completely written
+*/
+bool ms5805_codec_encoder::flush(void) {
+  uint8_t header[MS5805_CODEC_MAX_BLOCK_HEADER_SIZE];
+  uint8_t size = 0;
+
+  if (count == 0)
+    return true;
+
+  header[size++] = MS5805_CODEC_BLOCK_MARKER;
+  size += put_varint(header + size, used);
+  size += put_varint(header + size, count);
+
+  if (writer.write(header, size) != size)
+    return false;
+  if (writer.write(block, used) != used)
+    return false;
+
+  used = 0;
+  count = 0;
+
+  return true;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint8_t* : Log content
+* \param[in] size_t : Log length
+*/
+ms5805_codec_decoder::ms5805_codec_decoder(const uint8_t *data, size_t length)
+    : data(data), length(length), offset(0), block_end(0), remaining(0),
+      keyframe(false), last() {}
+
+/**
+* \brief Parse the log header.
+*
+* \param[out] ms5805_codec_header* : Header content
+*
+* \return bool : false if the header is missing or of unknown version
+*/
+bool ms5805_codec_decoder::read_header(struct ms5805_codec_header *header) {
+  uint8_t i;
+
+  if (length < MS5805_CODEC_HEADER_SIZE || data[0] != 'M' || data[1] != '5' ||
+      data[2] != 'Z' || data[3] != MS5805_CODEC_VERSION)
+    return false;
+
+  header->version = data[3];
+  header->kind = data[4];
+  header->osr = data[5];
+  for (i = 0; i < MS5805_CODEC_PROM_COUNT; i++)
+    header->coeff[i] = (uint16_t)((data[8 + i * 2] << 8) | data[9 + i * 2]);
+
+  offset = MS5805_CODEC_HEADER_SIZE;
+  remaining = 0;
+
+  return true;
+}
+
+/**
+* \brief Parse the block header at the current position.
+*
+* \param[out] uint32_t* : Length of the block payload
+* \param[out] uint32_t* : Number of samples in the block
+*
+* \return bool : false at the end of the log or on corrupted data
+*/
+bool ms5805_codec_decoder::read_block_header(uint32_t *payload_length,
+                                             uint32_t *count) {
+  size_t next = offset;
+
+  if (next >= length || data[next] != MS5805_CODEC_BLOCK_MARKER)
+    return false;
+  next++;
+  if (!get_varint(data, length, &next, payload_length) ||
+      !get_varint(data, length, &next, count))
+    return false;
+  if (*payload_length > length - next || *count == 0)
+    return false;
+
+  offset = next;
+
+  return true;
+}
+
+/**
+* \brief Decode the next sample, moving to the next block when needed.
+*
+* \param[out] ms5805_codec_sample* : Sample
+*
+* \return bool : false at the end of the log or on corrupted data
+*/
+bool ms5805_codec_decoder::read_sample(struct ms5805_codec_sample *sample) {
+  uint32_t payload_length;
+  uint32_t timestamp, temperature, pressure;
+
+  if (remaining == 0) {
+    if (!read_block_header(&payload_length, &remaining))
+      return false;
+    block_end = offset + payload_length;
+    keyframe = true;
+  }
+
+  // Samples are bounded by their block, so that a corrupted count fails
+  // instead of decoding the next block header
+  if (!get_varint(data, block_end, &offset, &timestamp) ||
+      !get_varint(data, block_end, &offset, &temperature) ||
+      !get_varint(data, block_end, &offset, &pressure)) {
+    remaining = 0;
+    return false;
+  }
+  remaining--;
+  if (remaining == 0 && offset != block_end)
+    return false;
+
+  if (keyframe) {
+    last.timestamp = timestamp;
+    last.temperature = zigzag_decode(temperature);
+    last.pressure = zigzag_decode(pressure);
+    keyframe = false;
+  } else {
+    last.timestamp += timestamp;
+    last.temperature =
+        (int32_t)((uint32_t)last.temperature + zigzag_decode(temperature));
+    last.pressure = (int32_t)((uint32_t)last.pressure + zigzag_decode(pressure));
+  }
+
+  *sample = last;
+
+  return true;
+}
+
+/**
+* \brief Move to the start of a block, to decode from there.
+*
+* \param[in] size_t : Offset of the block in the log
+*
+* \return bool : false if there is no block at this offset
+*/
+bool ms5805_codec_decoder::seek(size_t offset) {
+  if (offset >= length || data[offset] != MS5805_CODEC_BLOCK_MARKER)
+    return false;
+
+  this->offset = offset;
+  remaining = 0;
+
+  return true;
+}
+
+/**
+* \brief Skip the block at the current position without decoding it.
+*
+* \param[out] uint32_t* : Number of samples in the skipped block
+*
+* \return bool : false at the end of the log or on corrupted data
+*/
+bool ms5805_codec_decoder::skip_block(uint32_t *count) {
+  uint32_t payload_length;
+
+  if (remaining != 0)
+    return false;
+  if (!read_block_header(&payload_length, count))
+    return false;
+
+  offset += payload_length;
+
+  return true;
+}
+
+/**
+* \brief Current offset in the log, a block start when no block is being
+* decoded.
+*/
+size_t ms5805_codec_decoder::position(void) { return offset; }
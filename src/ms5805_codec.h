@@ -0,0 +1,178 @@
+#ifndef MS5805_CODEC_H
+#define MS5805_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ms5805_writer.h"
+
+/*
+ * Compressed sample log format. Unsigned values are LEB128 varints, signed
+ * values are zigzag-encoded varints.
+ *
+ * Header (22 bytes)
+ *   'M' '5' 'Z' version | kind | osr | 2 reserved bytes
+ *   | 7 PROM coefficients (2 bytes each, big-endian, zero if unused)
+ *
+ * Blocks, each decodable on its own for random access :
+ *   MS5805_CODEC_BLOCK_MARKER | payload length | sample count | payload
+ *   The payload holds the first sample (keyframe) as absolute values, then
+ *   each following sample as the difference with the previous one :
+ *   timestamp | temperature | pressure
+ */
+#define MS5805_CODEC_VERSION 1
+#define MS5805_CODEC_HEADER_SIZE 22
+#define MS5805_CODEC_PROM_COUNT 7
+#define MS5805_CODEC_BLOCK_MARKER 0xB5
+
+// Kinds of values stored in the log
+#define MS5805_CODEC_KIND_RAW 0         // D2 and D1 ADC values
+#define MS5805_CODEC_KIND_COMPENSATED 1 // 0.01 Celsius Degree and 0.01 mbar
+
+// Maximum number of samples between two keyframes
+#define MS5805_CODEC_DEFAULT_KEYFRAME_INTERVAL 32
+
+// Size of the block buffer of the encoder, bounding the RAM used
+#ifndef MS5805_CODEC_BLOCK_SIZE
+#define MS5805_CODEC_BLOCK_SIZE 128
+#endif
+
+struct ms5805_codec_header {
+  uint8_t version;
+  uint8_t kind;
+  uint8_t osr;
+  uint16_t coeff[MS5805_CODEC_PROM_COUNT];
+};
+
+struct ms5805_codec_sample {
+  uint32_t timestamp;
+  int32_t temperature;
+  int32_t pressure;
+};
+
+/**
+ * \brief Streaming encoder of the compressed sample log format. Only the
+ * current block is buffered.
+ */
+class ms5805_codec_encoder {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_writer& : Destination of the log
+   * \param[in] uint8_t : Maximum number of samples between two keyframes
+   */
+  ms5805_codec_encoder(
+      ms5805_writer &writer,
+      uint8_t keyframe_interval = MS5805_CODEC_DEFAULT_KEYFRAME_INTERVAL);
+
+  /**
+   * \brief Write the log header. Has to be called once, first.
+   *
+   * \param[in] uint8_t : Kind of values, MS5805_CODEC_KIND_RAW or
+   * MS5805_CODEC_KIND_COMPENSATED
+   * \param[in] uint16_t* : PROM coefficients for raw logs, may be NULL
+   * \param[in] uint8_t : Resolution used for the conversions
+   *
+   * \return bool : true if the header was completely written
+   */
+  bool write_header(uint8_t kind, const uint16_t *coeff, uint8_t osr);
+
+  /**
+   * \brief Add a sample to the log.
+   *
+   * \param[in] uint32_t : Sample time
+   * \param[in] int32_t : Temperature value
+   * \param[in] int32_t : Pressure value
+   *
+   * \return bool : false if a completed block could not be written
+   */
+  bool write_sample(uint32_t timestamp, int32_t temperature, int32_t pressure);
+
+  /**
+   * \brief Write the pending block. Has to be called before closing the log.
+   *
+   * \return bool : true if the block was completely written
+   */
+  bool flush(void);
+
+private:
+  ms5805_writer &writer;
+  uint8_t keyframe_interval;
+  uint8_t block[MS5805_CODEC_BLOCK_SIZE];
+  uint16_t used;
+  uint8_t count;
+  struct ms5805_codec_sample last;
+};
+
+/**
+ * \brief Decoder of the compressed sample log format, reading from memory
+ * (a block buffer or a memory-mapped file).
+ */
+class ms5805_codec_decoder {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint8_t* : Log content
+   * \param[in] size_t : Log length
+   */
+  ms5805_codec_decoder(const uint8_t *data, size_t length);
+
+  /**
+   * \brief Parse the log header.
+   *
+   * \param[out] ms5805_codec_header* : Header content
+   *
+   * \return bool : false if the header is missing or of unknown version
+   */
+  bool read_header(struct ms5805_codec_header *header);
+
+  /**
+   * \brief Decode the next sample, moving to the next block when needed.
+   *
+   * \param[out] ms5805_codec_sample* : Sample
+   *
+   * \return bool : false at the end of the log or on corrupted data
+   */
+  bool read_sample(struct ms5805_codec_sample *sample);
+
+  /**
+   * \brief Move to the start of a block, to decode from there.
+   *
+   * \param[in] size_t : Offset of the block in the log
+   *
+   * \return bool : false if there is no block at this offset
+   */
+  bool seek(size_t offset);
+
+  /**
+   * \brief Skip the block at the current position without decoding it.
+   *
+   * \param[out] uint32_t* : Number of samples in the skipped block
+   *
+   * \return bool : false at the end of the log or on corrupted data
+   */
+  bool skip_block(uint32_t *count);
+
+  /**
+   * \brief Current offset in the log, a block start when no block is being
+   * decoded.
+   */
+  size_t position(void);
+
+private:
+  bool read_block_header(uint32_t *payload_length, uint32_t *count);
+
+  const uint8_t *data;
+  size_t length;
+  size_t offset;
+  size_t block_end;
+  uint32_t remaining;
+  bool keyframe;
+  struct ms5805_codec_sample last;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "ms5805_compensation.h"
+
+// Coefficients indexes for temperature and pressure computation
+#define MS5805_COEFFICIENT_COUNT 7
+#define MS5805_PRESSURE_SENSITIVITY_INDEX 1
+#define MS5805_PRESSURE_OFFSET_INDEX 2
+#define MS5805_TEMP_COEFF_OF_PRESSURE_SENSITIVITY_INDEX 3
+#define MS5805_TEMP_COEFF_OF_PRESSURE_OFFSET_INDEX 4
+#define MS5805_REFERENCE_TEMPERATURE_INDEX 5
+#define MS5805_TEMP_COEFF_OF_TEMPERATURE_INDEX 6
+
+/**
+* \brief Compute the temperature and pressure from the raw ADC values.
+*
+* \param[in] uint16_t* : PROM coefficients, as read by the driver
+* \param[in] uint32_t : Temperature ADC value (D2)
+* \param[in] uint32_t : Pressure ADC value (D1)
+* \param[out] int32_t* : Temperature in 0.01 Celsius Degree
+* \param[out] int32_t* : Pressure in 0.01 mbar
+*/
+void ms5805_compensate(const uint16_t *coeff, uint32_t adc_temperature,
+                       uint32_t adc_pressure, int32_t *temperature,
+                       int32_t *pressure) {
+  int32_t dT, TEMP;
+  int64_t OFF, SENS, P, T2, OFF2, SENS2;
+
+  // Difference between actual and reference temperature = D2 - Tref
+  dT = (int32_t)adc_temperature -
+       ((int32_t)coeff[MS5805_REFERENCE_TEMPERATURE_INDEX] << 8);
+
+  // Actual temperature = 2000 + dT * TEMPSENS
+  TEMP = 2000 + ((int64_t)dT *
+                     (int64_t)coeff[MS5805_TEMP_COEFF_OF_TEMPERATURE_INDEX] >>
+                 23);
+
+  // Second order temperature compensation
+  if (TEMP < 2000) {
+    T2 = (3 * ((int64_t)dT * (int64_t)dT)) >> 33;
+    OFF2 = 61 * ((int64_t)TEMP - 2000) * ((int64_t)TEMP - 2000) / 16;
+    SENS2 = 29 * ((int64_t)TEMP - 2000) * ((int64_t)TEMP - 2000) / 16;
+
+    if (TEMP < -1500) {
+      OFF2 += 17 * ((int64_t)TEMP + 1500) * ((int64_t)TEMP + 1500);
+      SENS2 += 9 * ((int64_t)TEMP + 1500) * ((int64_t)TEMP + 1500);
+    }
+  } else {
+    T2 = (5 * ((int64_t)dT * (int64_t)dT)) >> 38;
+    OFF2 = 0;
+    SENS2 = 0;
+  }
+
+  // OFF = OFF_T1 + TCO * dT
+  OFF = ((int64_t)(coeff[MS5805_PRESSURE_OFFSET_INDEX]) << 17) +
+        (((int64_t)(coeff[MS5805_TEMP_COEFF_OF_PRESSURE_OFFSET_INDEX]) * dT) >>
+         6);
+  OFF -= OFF2;
+
+  // Sensitivity at actual temperature = SENS_T1 + TCS * dT
+  SENS = ((int64_t)coeff[MS5805_PRESSURE_SENSITIVITY_INDEX] << 16) +
+         (((int64_t)coeff[MS5805_TEMP_COEFF_OF_PRESSURE_SENSITIVITY_INDEX] *
+           dT) >>
+          7);
+  SENS -= SENS2;
+
+  // Temperature compensated pressure = D1 * SENS - OFF
+  P = (((adc_pressure * SENS) >> 21) - OFF) >> 15;
+
+  *temperature = (int32_t)(TEMP - T2);
+  *pressure = (int32_t)P;
+}
+
+/**
+* \brief Compute the 4-bits CRC of the PROM coefficients.
+*
+* \param[in] uint16_t* : PROM coefficients, CRC in the upper bits of the
+* first one
+*
+* \return uint8_t : CRC computed over the coefficients
+*/
+uint8_t ms5805_prom_crc(const uint16_t *coeff) {
+  uint16_t n_prom[MS5805_COEFFICIENT_COUNT + 1];
+  uint8_t cnt, n_bit;
+  uint16_t n_rem;
+
+  for (cnt = 0; cnt < MS5805_COEFFICIENT_COUNT; cnt++)
+    n_prom[cnt] = coeff[cnt];
+  n_prom[MS5805_COEFFICIENT_COUNT] = 0;
+  n_prom[0] = (0x0FFF & (n_prom[0])); // Clear the CRC byte
+
+  n_rem = 0x00;
+  for (cnt = 0; cnt < (MS5805_COEFFICIENT_COUNT + 1) * 2; cnt++) {
+
+    // Get next byte
+    if (cnt % 2 == 1)
+      n_rem ^= n_prom[cnt >> 1] & 0x00FF;
+    else
+      n_rem ^= n_prom[cnt >> 1] >> 8;
+
+    for (n_bit = 8; n_bit > 0; n_bit--) {
+
+      if (n_rem & 0x8000)
+        n_rem = (n_rem << 1) ^ 0x3000;
+      else
+        n_rem <<= 1;
+    }
+  }
+
+  return n_rem >> 12;
+}
@@ -0,0 +1,34 @@
+#ifndef MS5805_COMPENSATION_H
+#define MS5805_COMPENSATION_H
+
+#include <stdint.h>
+
+/*
+ * Compensation math of the MS5805, independent from the I2C driver so that raw
+ * captures can be compensated later, possibly on another machine.
+ */
+
+/**
+* \brief Compute the temperature and pressure from the raw ADC values.
+*
+* \param[in] uint16_t* : PROM coefficients, as read by the driver
+* \param[in] uint32_t : Temperature ADC value (D2)
+* \param[in] uint32_t : Pressure ADC value (D1)
+* \param[out] int32_t* : Temperature in 0.01 Celsius Degree
+* \param[out] int32_t* : Pressure in 0.01 mbar
+*/
+void ms5805_compensate(const uint16_t *coeff, uint32_t adc_temperature,
+                       uint32_t adc_pressure, int32_t *temperature,
+                       int32_t *pressure);
+
+/**
+* \brief Compute the 4-bits CRC of the PROM coefficients.
+*
+* \param[in] uint16_t* : PROM coefficients, CRC in the upper bits of the
+* first one
+*
+* \return uint8_t : CRC computed over the coefficients
+*/
+uint8_t ms5805_prom_crc(const uint16_t *coeff);
+
+#endif
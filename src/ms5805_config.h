@@ -0,0 +1,21 @@
+#ifndef MS5805_CONFIG_H
+#define MS5805_CONFIG_H
+
+/*
+ * Build-time options of the MS5805 library.
+ *
+ * The Arduino IDE does not forward the defines of a sketch to the library
+ * sources, so options changing the layout of the driver have to be enabled in
+ * this file (or through global compiler flags such as PlatformIO build_flags)
+ * to stay consistent between all translation units.
+ */
+
+// Count I2C transactions, bytes and errors and record per-phase latency
+// histograms. Disabled by default, in which case it has no code or RAM cost.
+// #define MS5805_ENABLE_INSTRUMENTATION
+
+// Run the altitude Kalman filter (ms5805_kalman.h) in 32-bits fixed point
+// instead of float, for cores without FPU.
+// #define MS5805_KALMAN_FIXED_POINT
+
+#endif
@@ -0,0 +1,242 @@
+#include "ms5805_coroutine.h"
+
+#ifdef MS5805_HAS_COROUTINES
+
+#include <exception>
+
+// Default time source of schedulers
+static ms5805_system_clock system_clock;
+
+/**
+* \brief Task object handed to the caller of the coroutine.
+*/
+ms5805_task ms5805_task::promise_type::get_return_object(void) {
+  return ms5805_task(
+      std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+/**
+* \brief Account for the end of the coroutine, whose frame is then released.
+*/
+std::suspend_never ms5805_task::promise_type::final_suspend(void) noexcept {
+  if (scheduler)
+    scheduler->tasks--;
+  return {};
+}
+
+/**
+* \brief Exceptions cannot propagate out of the scheduler.
+*/
+void ms5805_task::promise_type::unhandled_exception(void) { std::terminate(); }
+
+/**
+* \brief First resumption of the coroutine, scheduled by spawn().
+*/
+void ms5805_task::promise_type::expire(void) {
+  std::coroutine_handle<promise_type>::from_promise(*this).resume();
+}
+
+/**
+* \brief Class constructor
+*/
+ms5805_task::ms5805_task(std::coroutine_handle<promise_type> handle)
+    : handle(handle) {}
+
+/**
+* \brief Move constructor
+*/
+ms5805_task::ms5805_task(ms5805_task &&other) noexcept
+    : handle(other.handle) {
+  other.handle = nullptr;
+}
+
+/**
+* \brief Class destructor, releases coroutines which were never spawned.
+*/
+ms5805_task::~ms5805_task() {
+  if (handle)
+    handle.destroy();
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_scheduler* : Scheduler resuming the coroutine
+* \param[in] uint32_t : Duration in us
+*/
+ms5805_sleep_operation::ms5805_sleep_operation(ms5805_scheduler *scheduler,
+                                               uint32_t duration_us)
+    : scheduler(scheduler), duration_us(duration_us) {}
+
+/**
+* \brief Suspend the coroutine until the duration elapsed.
+*
+* \param[in] std::coroutine_handle<> : Awaiting coroutine
+*/
+void ms5805_sleep_operation::await_suspend(std::coroutine_handle<> handle) {
+  this->handle = handle;
+  scheduler->schedule(this, duration_us);
+}
+
+/**
+* \brief Resume the coroutine.
+*/
+void ms5805_sleep_operation::expire(void) { handle.resume(); }
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805* : Sensor to measure
+* \param[in] ms5805_scheduler* : Scheduler resuming the coroutine
+* \param[out] ms5805_sample* : Compensated sample
+*/
+ms5805_measure_operation::ms5805_measure_operation(
+    ms5805 *sensor, ms5805_scheduler *scheduler, struct ms5805_sample *sample)
+    : sensor(sensor), scheduler(scheduler), sample(sample),
+      status(ms5805_status_ok), state(ms5805_measurement_state_idle) {}
+
+/**
+* \brief Start the temperature conversion and suspend the coroutine until the
+* sample is complete. The coroutine continues at once if the conversion cannot
+* be started.
+*
+* \param[in] std::coroutine_handle<> : Awaiting coroutine
+*
+* \return bool : false if the coroutine has to continue at once
+*/
+bool ms5805_measure_operation::await_suspend(std::coroutine_handle<> handle) {
+  this->handle = handle;
+
+  status = sensor->begin_measurement(&state, sample);
+  if (status != ms5805_status_ok)
+    return false;
+
+  scheduler->schedule(this, sensor->get_conversion_time() * 1000UL);
+  return true;
+}
+
+/**
+* \brief Read the completed conversion, then start the next one or resume the
+* coroutine.
+*/
+void ms5805_measure_operation::expire(void) {
+  status = sensor->advance_measurement(&state, sample);
+
+  if (state != ms5805_measurement_state_idle)
+    scheduler->schedule(this, sensor->get_conversion_time() * 1000UL);
+  else
+    handle.resume();
+}
+
+/**
+* \brief Measure from a coroutine : co_await suspends it during the
+* conversions instead of waiting, letting the scheduler run other coroutines.
+*
+* \param[in] ms5805_scheduler& : Scheduler running the coroutine
+* \param[out] ms5805_sample* : Compensated sample
+*
+* \return ms5805_measure_operation : Awaitable, whose result is the
+* ms5805_status of the measurement
+*/
+ms5805_measure_operation ms5805::measure(ms5805_scheduler &scheduler,
+                                         struct ms5805_sample *sample) {
+  return ms5805_measure_operation(this, &scheduler, sample);
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_clock* : Time source, NULL for the system clock
+*/
+ms5805_scheduler::ms5805_scheduler(ms5805_clock *clock)
+    : clock(clock ? clock : &system_clock), timers(nullptr), tasks(0) {}
+
+/**
+* \brief Start a coroutine at the next run_once().
+*
+* \param[in] ms5805_task : Coroutine
+*/
+void ms5805_scheduler::spawn(ms5805_task task) {
+  ms5805_task::promise_type &promise = task.handle.promise();
+
+  // The frame now belongs to the scheduler, and is released on return
+  task.handle = nullptr;
+  promise.scheduler = this;
+  tasks++;
+  schedule(&promise, 0);
+}
+
+/**
+* \brief Call the expire() function of a timer after a delay.
+*
+* \param[in] ms5805_timer* : Timer, not scheduled already
+* \param[in] uint32_t : Delay in us
+*/
+void ms5805_scheduler::schedule(ms5805_timer *timer, uint32_t delay_us) {
+  ms5805_timer **position = &timers;
+
+  timer->deadline = clock->micros() + delay_us;
+
+  // Keep the list sorted, timers with the same deadline in order of arrival
+  while (*position &&
+         (int32_t)(timer->deadline - (*position)->deadline) >= 0)
+    position = &(*position)->next;
+
+  timer->next = *position;
+  *position = timer;
+}
+
+/**
+* \brief Awaitable suspending the calling coroutine.
+*
+* \param[in] uint32_t : Duration in us
+*/
+ms5805_sleep_operation ms5805_scheduler::sleep(uint32_t duration_us) {
+  return ms5805_sleep_operation(this, duration_us);
+}
+
+/**
+* \brief Expire all timers whose deadline is reached, without waiting.
+*
+* \param[out] uint32_t* : Optional, time until the next deadline in us
+*
+* \return bool : false if no timer is pending anymore
+*/
+bool ms5805_scheduler::run_once(uint32_t *delay_us) {
+  uint32_t now = clock->micros();
+  ms5805_timer *timer;
+
+  while (timers && (int32_t)(now - timers->deadline) >= 0) {
+    timer = timers;
+    timers = timer->next;
+    timer->next = nullptr;
+    timer->expire();
+    now = clock->micros();
+  }
+
+  if (timers == nullptr)
+    return false;
+
+  if (delay_us)
+    *delay_us = timers->deadline - now;
+
+  return true;
+}
+
+/**
+* \brief Run until no timer is pending, waiting with the clock between
+* deadlines. Delays are rounded up to the ms.
+*/
+void ms5805_scheduler::run(void) {
+  uint32_t delay_us;
+
+  while (run_once(&delay_us))
+    clock->delay((delay_us + 999) / 1000);
+}
+
+/**
+* \brief Number of coroutines started and not returned yet.
+*/
+uint32_t ms5805_scheduler::get_task_count(void) { return tasks; }
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef MS5805_COROUTINE_H
+#define MS5805_COROUTINE_H
+
+#include "ms5805.h"
+
+#ifdef MS5805_HAS_COROUTINES
+
+#include <coroutine>
+
+class ms5805_scheduler;
+
+/**
+ * \brief Entry of the scheduler deadline list. Awaitables derive from it and
+ * are linked into the list while their coroutine is suspended, so that
+ * scheduling never allocates.
+ */
+class ms5805_timer {
+
+public:
+  /**
+   * \brief Called by the scheduler once the deadline is reached.
+   */
+  virtual void expire(void) = 0;
+
+private:
+  friend class ms5805_scheduler;
+
+  ms5805_timer *next = nullptr;
+  uint32_t deadline = 0;
+};
+
+/**
+ * \brief Coroutine started with ms5805_scheduler::spawn(). Its frame is
+ * released when it returns.
+ */
+class ms5805_task {
+
+public:
+  struct promise_type : public ms5805_timer {
+    ms5805_scheduler *scheduler = nullptr;
+
+    ms5805_task get_return_object(void);
+    std::suspend_always initial_suspend(void) noexcept { return {}; }
+    std::suspend_never final_suspend(void) noexcept;
+    void return_void(void) {}
+    void unhandled_exception(void);
+    void expire(void);
+  };
+
+  ms5805_task(ms5805_task &&other) noexcept;
+  ~ms5805_task();
+
+private:
+  friend class ms5805_scheduler;
+
+  explicit ms5805_task(std::coroutine_handle<promise_type> handle);
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * \brief Awaitable suspending a coroutine for a given duration.
+ */
+class ms5805_sleep_operation : public ms5805_timer {
+
+public:
+  ms5805_sleep_operation(ms5805_scheduler *scheduler, uint32_t duration_us);
+
+  bool await_ready(void) { return duration_us == 0; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume(void) {}
+  void expire(void);
+
+private:
+  ms5805_scheduler *scheduler;
+  uint32_t duration_us;
+  std::coroutine_handle<> handle;
+};
+
+/**
+ * \brief Awaitable returned by ms5805::measure(). Runs the temperature and
+ * pressure conversions as scheduler timers and resumes the coroutine with
+ * the status once the sample is compensated.
+ */
+class ms5805_measure_operation : public ms5805_timer {
+
+public:
+  ms5805_measure_operation(ms5805 *sensor, ms5805_scheduler *scheduler,
+                           struct ms5805_sample *sample);
+
+  bool await_ready(void) { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  enum ms5805_status await_resume(void) { return status; }
+  void expire(void);
+
+private:
+  ms5805 *sensor;
+  ms5805_scheduler *scheduler;
+  struct ms5805_sample *sample;
+  std::coroutine_handle<> handle;
+  enum ms5805_status status;
+  volatile enum ms5805_measurement_state state;
+};
+
+/**
+ * \brief Cooperative single-threaded scheduler. Suspended coroutines wait in
+ * a list sorted by deadline, so hundreds of sensors can be interleaved
+ * without threads.
+ */
+class ms5805_scheduler {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_clock* : Time source, NULL for the system clock
+   */
+  ms5805_scheduler(ms5805_clock *clock = nullptr);
+
+  /**
+   * \brief Start a coroutine at the next run_once().
+   *
+   * \param[in] ms5805_task : Coroutine
+   */
+  void spawn(ms5805_task task);
+
+  /**
+   * \brief Call the expire() function of a timer after a delay.
+   *
+   * \param[in] ms5805_timer* : Timer, not scheduled already
+   * \param[in] uint32_t : Delay in us
+   */
+  void schedule(ms5805_timer *timer, uint32_t delay_us);
+
+  /**
+   * \brief Awaitable suspending the calling coroutine.
+   *
+   * \param[in] uint32_t : Duration in us
+   */
+  ms5805_sleep_operation sleep(uint32_t duration_us);
+
+  /**
+   * \brief Expire all timers whose deadline is reached, without waiting.
+   *
+   * \param[out] uint32_t* : Optional, time until the next deadline in us
+   *
+   * \return bool : false if no timer is pending anymore
+   */
+  bool run_once(uint32_t *delay_us = nullptr);
+
+  /**
+   * \brief Run until no timer is pending, waiting with the clock between
+   * deadlines. Delays are rounded up to the ms.
+   */
+  void run(void);
+
+  /**
+   * \brief Number of coroutines started and not returned yet.
+   */
+  uint32_t get_task_count(void);
+
+private:
+  friend struct ms5805_task::promise_type;
+
+  ms5805_clock *clock;
+  ms5805_timer *timers;
+  uint32_t tasks;
+};
+
+#endif
+
+#endif
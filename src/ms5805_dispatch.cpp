@@ -0,0 +1,85 @@
+#include <stddef.h>
+
+#include "ms5805_dispatch.h"
+
+/**
+* \brief Class constructor
+*/
+ms5805_dispatcher::ms5805_dispatcher() : subscribers() {}
+
+/**
+* \brief Register a consumer.
+*
+* \param[in] ms5805_subscriber_callback : Function called with samples
+* \param[in] void* : Context passed to the callback
+* \param[in] uint16_t : Rate divider, 1 to receive every sample, n to receive
+* one sample out of n
+* \param[in] ms5805_stage* : Optional pipeline applied before the divider
+*
+* \return int8_t : Subscription handle, -1 if all slots are used
+*/
+int8_t ms5805_dispatcher::subscribe(ms5805_subscriber_callback callback,
+                                    void *context, uint16_t divider,
+                                    ms5805_stage *stage) {
+  int8_t i;
+
+  if (callback == NULL)
+    return -1;
+
+  for (i = 0; i < MS5805_MAX_SUBSCRIBERS; i++) {
+    struct ms5805_subscriber *subscriber = &subscribers[i];
+
+    if (subscriber->callback != NULL)
+      continue;
+
+    subscriber->context = context;
+    subscriber->stage = stage;
+    subscriber->divider = divider ? divider : 1;
+    subscriber->count = 0;
+    subscriber->callback = callback;
+    return i;
+  }
+
+  return -1;
+}
+
+/**
+* \brief Remove a consumer.
+*
+* \param[in] int8_t : Handle returned by subscribe()
+*/
+void ms5805_dispatcher::unsubscribe(int8_t handle) {
+  if (handle >= 0 && handle < MS5805_MAX_SUBSCRIBERS)
+    subscribers[handle].callback = NULL;
+}
+
+/**
+* \brief Deliver a sample to the consumers whose divider is due.
+*
+* \param[in] ms5805_sample* : New sample
+*/
+void ms5805_dispatcher::publish(const struct ms5805_sample *sample) {
+  uint8_t i;
+
+  for (i = 0; i < MS5805_MAX_SUBSCRIBERS; i++) {
+    struct ms5805_subscriber *subscriber = &subscribers[i];
+    const struct ms5805_sample *output = sample;
+    struct ms5805_sample processed;
+
+    if (subscriber->callback == NULL)
+      continue;
+
+    if (subscriber->stage) {
+      processed = *sample;
+      if (!subscriber->stage->run(&processed))
+        continue;
+      output = &processed;
+    }
+
+    if (++subscriber->count < subscriber->divider)
+      continue;
+    subscriber->count = 0;
+
+    subscriber->callback(output, subscriber->context);
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef MS5805_DISPATCH_H
+#define MS5805_DISPATCH_H
+
+#include "ms5805_sample.h"
+#include "ms5805_stage.h"
+
+// Number of subscribers of a dispatcher
+#ifndef MS5805_MAX_SUBSCRIBERS
+#define MS5805_MAX_SUBSCRIBERS 4
+#endif
+
+/**
+ * \brief Function receiving samples from a dispatcher.
+ *
+ * \param[in] ms5805_sample* : Sample, only valid during the call
+ * \param[in] void* : Context given at subscription
+ */
+typedef void (*ms5805_subscriber_callback)(const struct ms5805_sample *sample,
+                                           void *context);
+
+/**
+ * \brief Distributes the samples of one sensor to several consumers, each at
+ * its own rate. The sensor is read once, at the rate of the fastest consumer.
+ *
+ * Consumers without a stage receive the published sample itself. Consumers
+ * with a stage receive a copy processed by it, the stage seeing every sample
+ * so that it can filter before decimation.
+ */
+class ms5805_dispatcher {
+
+public:
+  ms5805_dispatcher();
+
+  /**
+   * \brief Register a consumer.
+   *
+   * \param[in] ms5805_subscriber_callback : Function called with samples
+   * \param[in] void* : Context passed to the callback
+   * \param[in] uint16_t : Rate divider, 1 to receive every sample, n to
+   * receive one sample out of n
+   * \param[in] ms5805_stage* : Optional pipeline applied before the divider
+   *
+   * \return int8_t : Subscription handle, -1 if all slots are used
+   */
+  int8_t subscribe(ms5805_subscriber_callback callback, void *context,
+                   uint16_t divider = 1, ms5805_stage *stage = NULL);
+
+  /**
+   * \brief Remove a consumer.
+   *
+   * \param[in] int8_t : Handle returned by subscribe()
+   */
+  void unsubscribe(int8_t handle);
+
+  /**
+   * \brief Deliver a sample to the consumers whose divider is due.
+   *
+   * \param[in] ms5805_sample* : New sample
+   */
+  void publish(const struct ms5805_sample *sample);
+
+private:
+  struct ms5805_subscriber {
+    ms5805_subscriber_callback callback;
+    void *context;
+    ms5805_stage *stage;
+    uint16_t divider;
+    uint16_t count;
+  };
+
+  struct ms5805_subscriber subscribers[MS5805_MAX_SUBSCRIBERS];
+};
+
+#endif
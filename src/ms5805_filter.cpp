@@ -0,0 +1,412 @@
+#include <string.h>
+
+#include "ms5805_filter.h"
+
+#define MS5805_EMA_MAX_SHIFT 16
+
+/**
+* \brief Divide by a power of two, rounding half away from zero.
+*
+* \param[in] int64_t : Value
+* \param[in] uint8_t : Shift, 0 to MS5805_EMA_MAX_SHIFT
+*
+* \return int64_t : Rounded quotient
+*/
+static int64_t ms5805_round_shift(int64_t value, uint8_t shift) {
+  int64_t half = ((int64_t)1 << shift) >> 1;
+
+  if (value >= 0)
+    return (value + half) >> shift;
+  return -((half - value) >> shift);
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint8_t : Smoothing shift, 0 to 16, 0 passes samples through
+* \param[in] uint8_t : Fields to filter, MS5805_FIELD_* mask
+*/
+ms5805_ema_filter::ms5805_ema_filter(uint8_t shift, uint8_t fields)
+    : shift(shift > MS5805_EMA_MAX_SHIFT ? MS5805_EMA_MAX_SHIFT : shift),
+      fields(fields), primed(false), state() {}
+
+/**
+* \brief Filter the selected fields of a sample.
+*
+* \param[in,out] ms5805_sample* : Sample
+*
+* \return bool : true, samples are never dropped
+*/
+bool ms5805_ema_filter::process(struct ms5805_sample *sample) {
+  uint8_t field;
+  int64_t input;
+
+  for (field = 0; field < ms5805_sample_field_count; field++) {
+    if (!(fields & (1 << field)))
+      continue;
+
+    // Multiplied rather than shifted : fields may be negative
+    input = (int64_t)ms5805_get_field(sample,
+                                      (enum ms5805_sample_field)field) *
+            ((int64_t)1 << shift);
+
+    // Round the update half away from zero, so that the output settles on
+    // constant inputs from both directions instead of staying one unit off
+    if (!primed)
+      state[field] = input;
+    else
+      state[field] += ms5805_round_shift(input - state[field], shift);
+
+    ms5805_set_field(sample, (enum ms5805_sample_field)field,
+                     (int32_t)ms5805_round_shift(state[field], shift));
+  }
+  primed = true;
+
+  return true;
+}
+
+/**
+* \brief Restart from the next sample.
+*/
+void ms5805_ema_filter::reset(void) { primed = false; }
+
+/**
+* \brief Change the smoothing, keeping the current output.
+*
+* \param[in] uint8_t : Smoothing shift, 0 to 16
+*/
+void ms5805_ema_filter::set_shift(uint8_t shift) {
+  uint8_t field;
+
+  if (shift > MS5805_EMA_MAX_SHIFT)
+    shift = MS5805_EMA_MAX_SHIFT;
+
+  // Rounded like the updates of process()
+  for (field = 0; field < ms5805_sample_field_count; field++) {
+    if (shift > this->shift)
+      state[field] *= (int64_t)1 << (shift - this->shift);
+    else
+      state[field] = ms5805_round_shift(state[field], this->shift - shift);
+  }
+  this->shift = shift;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_sample_field : Field to decimate
+* \param[in] uint8_t : Number of stages, 1 to MS5805_CIC_MAX_ORDER
+* \param[in] uint16_t : Decimation ratio, 1 to MS5805_CIC_MAX_RATIO
+*/
+ms5805_cic_decimator::ms5805_cic_decimator(enum ms5805_sample_field field,
+                                           uint8_t order, uint16_t ratio)
+    : field(field), order(order), ratio(ratio) {
+  uint8_t i;
+
+  if (this->order < 1)
+    this->order = 1;
+  if (this->order > MS5805_CIC_MAX_ORDER)
+    this->order = MS5805_CIC_MAX_ORDER;
+  if (this->ratio < 1)
+    this->ratio = 1;
+  if (this->ratio > MS5805_CIC_MAX_RATIO)
+    this->ratio = MS5805_CIC_MAX_RATIO;
+
+  gain = 1;
+  for (i = 0; i < this->order; i++)
+    gain *= this->ratio;
+
+  reset();
+}
+
+/**
+* \brief Integrate a sample, and output the decimated value every ratio
+* samples.
+*
+* \param[in,out] ms5805_sample* : Sample
+*
+* \return bool : false if the sample is absorbed, true with the decimated
+* value
+*/
+bool ms5805_cic_decimator::process(struct ms5805_sample *sample) {
+  uint64_t value = (uint64_t)(int64_t)ms5805_get_field(sample, field);
+  uint64_t previous;
+  int64_t output;
+  uint8_t i;
+
+  for (i = 0; i < order; i++) {
+    integrator[i] += value;
+    value = integrator[i];
+  }
+
+  if (++count < ratio)
+    return false;
+  count = 0;
+
+  for (i = 0; i < order; i++) {
+    previous = comb[i];
+    comb[i] = value;
+    value -= previous;
+  }
+
+  // Divide by the gain, rounding half away from zero
+  output = (int64_t)value;
+  if (output >= 0)
+    output = (int64_t)(((uint64_t)output + gain / 2) / gain);
+  else
+    output = -(int64_t)(((uint64_t)-output + gain / 2) / gain);
+
+  ms5805_set_field(sample, field, (int32_t)output);
+
+  return true;
+}
+
+/**
+* \brief Clear the integrators and combs.
+*/
+void ms5805_cic_decimator::reset(void) {
+  uint8_t i;
+
+  count = 0;
+  for (i = 0; i < MS5805_CIC_MAX_ORDER; i++) {
+    integrator[i] = 0;
+    comb[i] = 0;
+  }
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_sample_field : Field to check
+* \param[in] uint8_t : Window size, odd, 3 to MS5805_HAMPEL_MAX_WINDOW
+* \param[in] uint8_t : Threshold in standard deviations, typically 3
+* \param[in] ms5805_hampel_mode : What to do with outliers
+* \param[in] int32_t : Smallest deviation considered as an outlier, for windows
+* of nearly constant values whose MAD is 0
+*/
+ms5805_hampel_filter::ms5805_hampel_filter(enum ms5805_sample_field field,
+                                           uint8_t window, uint8_t threshold,
+                                           enum ms5805_hampel_mode mode,
+                                           int32_t min_deviation)
+    : field(field), window(window), threshold(threshold), mode(mode),
+      min_deviation(min_deviation) {
+  if (this->window > MS5805_HAMPEL_MAX_WINDOW)
+    this->window = MS5805_HAMPEL_MAX_WINDOW;
+  if (this->window < 3)
+    this->window = 3;
+  // The median has to be a sample of the window
+  if ((this->window & 1) == 0)
+    this->window--;
+
+  reset();
+}
+
+/**
+* \brief Index of the first value of a sorted array which is not lower than a
+* value.
+*
+* \param[in] int32_t* : Sorted values
+* \param[in] uint8_t : Number of values
+* \param[in] int32_t : Value
+*
+* \return uint8_t : Index, between 0 and the number of values
+*/
+static uint8_t lower_bound(const int32_t *values, uint8_t count,
+                           int32_t value) {
+  uint8_t low = 0, high = count, middle;
+
+  while (low < high) {
+    middle = (low + high) / 2;
+    if (values[middle] < value)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  return low;
+}
+
+/**
+* \brief Check a sample against the window, which it then enters.
+*
+* \param[in,out] ms5805_sample* : Sample
+*
+* \return bool : false if the sample is an outlier and outliers are dropped
+*/
+bool ms5805_hampel_filter::process(struct ms5805_sample *sample) {
+  int32_t value = ms5805_get_field(sample, field);
+  int32_t median, old;
+  int64_t deviation, limit;
+  uint8_t from, to;
+
+  if (count < window) {
+    to = lower_bound(sorted, count, value);
+    memmove(&sorted[to + 1], &sorted[to], (count - to) * sizeof(int32_t));
+    sorted[to] = value;
+    history[count++] = value;
+    if (count < window)
+      return true;
+  } else {
+    // The new value takes the sorted place of the oldest one, moving the
+    // values in between by one position
+    old = history[oldest];
+    history[oldest] = value;
+    if (++oldest == window)
+      oldest = 0;
+
+    from = lower_bound(sorted, window, old);
+    to = lower_bound(sorted, window, value);
+    if (to > from) {
+      memmove(&sorted[from], &sorted[from + 1],
+              (to - 1 - from) * sizeof(int32_t));
+      sorted[to - 1] = value;
+    } else {
+      memmove(&sorted[to + 1], &sorted[to], (from - to) * sizeof(int32_t));
+      sorted[to] = value;
+    }
+  }
+
+  median = sorted[window / 2];
+  deviation = (int64_t)value - median;
+  if (deviation < 0)
+    deviation = -deviation;
+
+  // The standard deviation of normal noise is 1.4826 MAD, here 1518 / 1024
+  limit = ((int64_t)threshold * median_absolute_deviation(median) * 1518) >> 10;
+  if (limit < min_deviation)
+    limit = min_deviation;
+
+  if (deviation <= limit)
+    return true;
+
+  outliers++;
+  switch (mode) {
+  case ms5805_hampel_mode_replace:
+    ms5805_set_field(sample, field, median);
+    break;
+  case ms5805_hampel_mode_flag:
+    sample->flags |= MS5805_SAMPLE_FLAG_OUTLIER;
+    break;
+  case ms5805_hampel_mode_drop:
+    return false;
+  }
+
+  return true;
+}
+
+/**
+* \brief Median of the distances of the window values to their median. The
+* distances are increasing on both sides of the median in the sorted window,
+* so they are merged from there until the middle one.
+*
+* \param[in] int32_t : Median of the window
+*
+* \return int32_t : Median absolute deviation
+*/
+int32_t ms5805_hampel_filter::median_absolute_deviation(int32_t median) {
+  int8_t left = window / 2 - 1;
+  uint8_t right = window / 2 + 1;
+  uint8_t rank;
+  int32_t distance = 0;
+
+  // The median itself is the smallest distance, 0
+  for (rank = 0; rank < window / 2; rank++) {
+    if (right >= window ||
+        (left >= 0 && median - sorted[left] <= sorted[right] - median))
+      distance = median - sorted[left--];
+    else
+      distance = sorted[right++] - median;
+  }
+
+  return distance;
+}
+
+/**
+* \brief Empty the window.
+*/
+void ms5805_hampel_filter::reset(void) {
+  count = 0;
+  oldest = 0;
+  outliers = 0;
+}
+
+/**
+* \brief Number of outliers found since the last reset.
+*/
+uint32_t ms5805_hampel_filter::get_outlier_count(void) { return outliers; }
+
+/**
+* \brief Class constructor
+*
+* \param[in] int32_t : Temperature deadband in 0.01 Celsius Degree, INT32_MAX
+* to ignore temperature
+* \param[in] int32_t : Pressure deadband in 0.01 mbar, INT32_MAX to ignore
+* pressure
+* \param[in] uint32_t : Longest time without passing a sample in us, up to
+* about 71 minutes, 0 for no limit
+*/
+ms5805_deadband::ms5805_deadband(int32_t temperature_threshold,
+                                 int32_t pressure_threshold,
+                                 uint32_t max_silence_us)
+    : temperature_threshold(temperature_threshold),
+      pressure_threshold(pressure_threshold), max_silence(max_silence_us) {
+  reset();
+}
+
+/**
+* \brief Check whether a value moved by more than a deadband from a reference.
+*
+* \param[in] int32_t : Value
+* \param[in] int32_t : Reference value
+* \param[in] int32_t : Deadband
+*
+* \return bool : true if the value is out of the deadband
+*/
+static bool ms5805_outside_deadband(int32_t value, int32_t reference,
+                                    int32_t threshold) {
+  int64_t deviation = (int64_t)value - reference;
+
+  if (deviation < 0)
+    deviation = -deviation;
+
+  return deviation > threshold;
+}
+
+/**
+* \brief Pass the sample if it moved out of the deadband or if the silence
+* lasted too long.
+*
+* \param[in] ms5805_sample* : Sample, left unchanged
+*
+* \return bool : false if the sample is dropped
+*/
+bool ms5805_deadband::process(struct ms5805_sample *sample) {
+  if (reported &&
+      !ms5805_outside_deadband(sample->temperature, temperature,
+                               temperature_threshold) &&
+      !ms5805_outside_deadband(sample->pressure, pressure,
+                               pressure_threshold) &&
+      (max_silence == 0 || sample->timestamp - timestamp < max_silence)) {
+    suppressed++;
+    return false;
+  }
+
+  reported = true;
+  timestamp = sample->timestamp;
+  temperature = sample->temperature;
+  pressure = sample->pressure;
+  return true;
+}
+
+/**
+* \brief Pass the next sample, and clear the dropped samples count.
+*/
+void ms5805_deadband::reset(void) {
+  reported = false;
+  suppressed = 0;
+}
+
+/**
+* \brief Number of samples dropped since the last reset.
+*/
+uint32_t ms5805_deadband::get_suppressed_count(void) { return suppressed; }
@@ -0,0 +1,198 @@
+#ifndef MS5805_FILTER_H
+#define MS5805_FILTER_H
+
+#include "ms5805_stage.h"
+
+// Cascaded integrator-comb limits : 24-bits inputs grow by order * log2(ratio)
+// bits in the 64-bits integrators
+#define MS5805_CIC_MAX_ORDER 4
+#define MS5805_CIC_MAX_RATIO 512
+
+// Largest window of the outlier filter
+#ifndef MS5805_HAMPEL_MAX_WINDOW
+#define MS5805_HAMPEL_MAX_WINDOW 15
+#endif
+
+enum ms5805_hampel_mode {
+  ms5805_hampel_mode_replace, // Outliers are replaced by the window median
+  ms5805_hampel_mode_flag,    // Outliers get MS5805_SAMPLE_FLAG_OUTLIER
+  ms5805_hampel_mode_drop     // Outliers are dropped
+};
+
+/**
+ * \brief Exponential moving average, a first-order IIR low-pass filter, in
+ * fixed point : y += (x - y) / 2^shift.
+ *
+ * The time constant is about 2^shift samples, the -3 dB cutoff about
+ * fs / (2 * pi * 2^shift). The state keeps shift fractional bits so that
+ * small changes are not lost to rounding. The filter starts from the first
+ * sample instead of 0.
+ */
+class ms5805_ema_filter : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint8_t : Smoothing shift, 0 to 16, 0 passes samples through
+   * \param[in] uint8_t : Fields to filter, MS5805_FIELD_* mask
+   */
+  ms5805_ema_filter(uint8_t shift, uint8_t fields = MS5805_FIELD_COMPENSATED);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Change the smoothing, keeping the current output.
+   *
+   * \param[in] uint8_t : Smoothing shift, 0 to 16
+   */
+  void set_shift(uint8_t shift);
+
+private:
+  uint8_t shift;
+  uint8_t fields;
+  bool primed;
+  // Filter outputs scaled by 2^shift
+  int64_t state[ms5805_sample_field_count];
+};
+
+/**
+ * \brief Cascaded integrator-comb decimator : averages ratio samples into one
+ * with a sinc^order response, trading sample rate for resolution. For
+ * instance fast OSR 256 conversions decimated by 32 come out at about the
+ * rate of OSR 8192 conversions, and the ratio and order select any other
+ * point of the rate and noise trade-off.
+ *
+ * Integrators wrap around on 64-bits, which the combs cancel exactly. Only one
+ * output out of ratio samples goes through, dividing the sum by
+ * ratio^order. The other fields and the timestamp are those of the last
+ * input. The first order - 1 outputs are transients.
+ */
+class ms5805_cic_decimator : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_sample_field : Field to decimate
+   * \param[in] uint8_t : Number of stages, 1 to MS5805_CIC_MAX_ORDER
+   * \param[in] uint16_t : Decimation ratio, 1 to MS5805_CIC_MAX_RATIO
+   */
+  ms5805_cic_decimator(enum ms5805_sample_field field, uint8_t order,
+                       uint16_t ratio);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+private:
+  enum ms5805_sample_field field;
+  uint8_t order;
+  uint16_t ratio;
+  uint16_t count;
+  uint64_t gain;
+  uint64_t integrator[MS5805_CIC_MAX_ORDER];
+  uint64_t comb[MS5805_CIC_MAX_ORDER];
+};
+
+/**
+ * \brief Hampel outlier filter : a sample is an outlier when it is further
+ * from the median of the last window samples than threshold times the
+ * standard deviation estimated from the median absolute deviation (MAD).
+ *
+ * The filter is causal : the window ends with the sample under test, so no
+ * delay is added, and a genuine step is accepted once it fills half of the
+ * window. The window is kept sorted, a new sample taking the place of the
+ * oldest one after a binary search. Detection starts once the window is
+ * full.
+ */
+class ms5805_hampel_filter : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_sample_field : Field to check
+   * \param[in] uint8_t : Window size, odd, 3 to MS5805_HAMPEL_MAX_WINDOW
+   * \param[in] uint8_t : Threshold in standard deviations, typically 3
+   * \param[in] ms5805_hampel_mode : What to do with outliers
+   * \param[in] int32_t : Smallest deviation considered as an outlier, for
+   * windows of nearly constant values whose MAD is 0
+   */
+  ms5805_hampel_filter(enum ms5805_sample_field field, uint8_t window,
+                       uint8_t threshold,
+                       enum ms5805_hampel_mode mode =
+                           ms5805_hampel_mode_replace,
+                       int32_t min_deviation = 1);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Number of outliers found since the last reset.
+   */
+  uint32_t get_outlier_count(void);
+
+private:
+  int32_t median_absolute_deviation(int32_t median);
+
+  enum ms5805_sample_field field;
+  uint8_t window;
+  uint8_t threshold;
+  enum ms5805_hampel_mode mode;
+  int32_t min_deviation;
+  uint8_t count;
+  uint8_t oldest;
+  uint32_t outliers;
+  int32_t history[MS5805_HAMPEL_MAX_WINDOW]; // In arrival order
+  int32_t sorted[MS5805_HAMPEL_MAX_WINDOW];
+};
+
+
+/**
+ * \brief Report by exception : passes a sample only when its compensated
+ * temperature or pressure moved by more than a deadband from the last sample
+ * passed, or when nothing was passed for too long, and drops the others.
+ *
+ * Comparing with the last sample passed rather than with the previous one,
+ * slow drifts are reported once they add up to the deadband, and noise
+ * within the deadband is never reported. The first sample after a reset
+ * always passes.
+ */
+class ms5805_deadband : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] int32_t : Temperature deadband in 0.01 Celsius Degree,
+   * INT32_MAX to ignore temperature
+   * \param[in] int32_t : Pressure deadband in 0.01 mbar, INT32_MAX to ignore
+   * pressure
+   * \param[in] uint32_t : Longest time without passing a sample in us, up to
+   * about 71 minutes, 0 for no limit
+   */
+  ms5805_deadband(int32_t temperature_threshold, int32_t pressure_threshold,
+                  uint32_t max_silence_us = 0);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Number of samples dropped since the last reset.
+   */
+  uint32_t get_suppressed_count(void);
+
+private:
+  int32_t temperature_threshold;
+  int32_t pressure_threshold;
+  uint32_t max_silence;
+  bool reported;
+  uint32_t suppressed;
+  // Last sample passed
+  uint32_t timestamp;
+  int32_t temperature;
+  int32_t pressure;
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "ms5805_kalman.h"
+
+// Initial uncertainties of the vertical speed, in (m/s)^2, and of the
+// accelerometer bias, in (m/s2)^2
+#define MS5805_KALMAN_INITIAL_VELOCITY_VARIANCE 10.0f
+#define MS5805_KALMAN_INITIAL_BIAS_VARIANCE 0.25f
+
+// Default accelerometer noise and bias random walk
+#define MS5805_KALMAN_ACCELEROMETER_NOISE 0.3f
+#define MS5805_KALMAN_BIAS_NOISE 0.01f
+
+// Arithmetic on values (altitude, velocity) and variances (covariances,
+// gains, durations), multiplications always involving a variance
+#ifdef MS5805_KALMAN_FIXED_POINT
+#define MS5805_KALMAN_VALUE(x) ((ms5805_kalman_value)((x)*65536.0f))
+#define MS5805_KALMAN_VARIANCE(x) ((ms5805_kalman_variance)((x)*1048576.0f))
+#define MS5805_KALMAN_TO_FLOAT(value) ((float)(value) / 65536.0f)
+#define MS5805_KALMAN_CENTIMETRES(cm)                                          \
+  ((ms5805_kalman_value)(((int64_t)(cm) << 16) / 100))
+#define MS5805_KALMAN_SECONDS(us)                                              \
+  ((ms5805_kalman_variance)(((uint64_t)(us) << 20) / 1000000))
+#define MS5805_KALMAN_MUL(variance, x)                                         \
+  ((int32_t)(((int64_t)(variance) * (x) + (1 << 19)) >> 20))
+#define MS5805_KALMAN_DIV(a, b) ((int32_t)(((int64_t)(a) << 20) / (b)))
+#else
+#define MS5805_KALMAN_VALUE(x) ((float)(x))
+#define MS5805_KALMAN_VARIANCE(x) ((float)(x))
+#define MS5805_KALMAN_TO_FLOAT(value) (value)
+#define MS5805_KALMAN_CENTIMETRES(cm) ((float)(cm)*0.01f)
+#define MS5805_KALMAN_SECONDS(us) ((float)(us)*1e-6f)
+#define MS5805_KALMAN_MUL(variance, x) ((variance) * (x))
+#define MS5805_KALMAN_DIV(a, b) ((a) / (b))
+#endif
+
+/**
+* \brief Class constructor
+*
+* \param[in] float : Process noise, standard deviation of the vertical
+* acceleration in m/s2
+* \param[in] float : Measurement noise, standard deviation of the barometric
+* altitude in m
+*/
+ms5805_kalman::ms5805_kalman(float acceleration_noise, float altitude_noise) {
+  ms5805_set_altitude_reference(&reference, MS5805_STANDARD_PRESSURE);
+  set_process_noise(acceleration_noise);
+  set_accelerometer_noise(MS5805_KALMAN_ACCELEROMETER_NOISE,
+                          MS5805_KALMAN_BIAS_NOISE);
+  set_measurement_noise(altitude_noise);
+  reset();
+}
+
+/**
+* \brief Update the estimate with the pressure of a sample, which is left
+* unchanged.
+*
+* \param[in] ms5805_sample* : Sample
+*
+* \return bool : true, samples are never dropped
+*/
+bool ms5805_kalman::process(struct ms5805_sample *sample) {
+  update_pressure(sample->pressure, sample->timestamp);
+  return true;
+}
+
+/**
+* \brief Restart from the next measurement.
+*/
+void ms5805_kalman::reset(void) {
+  initialized = false;
+  aided = false;
+  time = 0;
+  acceleration = 0;
+  altitude = 0;
+  velocity = 0;
+  bias = 0;
+  p00 = 0;
+  p01 = 0;
+  p02 = 0;
+  p11 = 0;
+  p12 = 0;
+  p22 = 0;
+}
+
+/**
+* \brief Set the process noise : larger values follow altitude changes faster,
+* smaller values smooth more.
+*
+* \param[in] float : Standard deviation of the vertical acceleration in m/s2
+*/
+void ms5805_kalman::set_process_noise(float acceleration_noise) {
+  acceleration_variance =
+      MS5805_KALMAN_VARIANCE(acceleration_noise * acceleration_noise);
+}
+
+/**
+* \brief Set the accelerometer noise, used instead of the process noise once
+* accelerations are given.
+*
+* \param[in] float : Standard deviation of the acceleration in m/s2
+* \param[in] float : Bias random walk in m/s2 per square root of s
+*/
+void ms5805_kalman::set_accelerometer_noise(float acceleration_noise,
+                                            float bias_noise) {
+  accelerometer_variance =
+      MS5805_KALMAN_VARIANCE(acceleration_noise * acceleration_noise);
+  bias_variance = MS5805_KALMAN_VARIANCE(bias_noise * bias_noise);
+}
+
+/**
+* \brief Set the measurement noise.
+*
+* \param[in] float : Standard deviation of the barometric altitude in m
+*/
+void ms5805_kalman::set_measurement_noise(float altitude_noise) {
+  altitude_variance = MS5805_KALMAN_VARIANCE(altitude_noise * altitude_noise);
+}
+
+/**
+* \brief Set the pressure of the altitude reference, 1013.25 mbar by default.
+*
+* \param[in] float : Reference pressure in mbar
+*/
+void ms5805_kalman::set_reference_pressure(float pressure) {
+  ms5805_set_altitude_reference(&reference, (int32_t)(pressure * 100 + 0.5f));
+}
+
+/**
+* \brief Set the altitude reference, for instance the one of a sensor
+* calibrated with ms5805::calibrate_qnh().
+*
+* \param[in] ms5805_altitude_reference* : Reference, copied
+*/
+void ms5805_kalman::set_altitude_reference(
+    const struct ms5805_altitude_reference *reference) {
+  this->reference = *reference;
+}
+
+/**
+* \brief Correct the estimate with a pressure measurement.
+*
+* \param[in] int32_t : Pressure in 0.01 mbar
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_kalman::update_pressure(int32_t pressure, uint32_t timestamp) {
+  correct(MS5805_KALMAN_CENTIMETRES(ms5805_altitude_cm(pressure, &reference)),
+          timestamp);
+}
+
+/**
+* \brief Correct the estimate with an altitude measurement.
+*
+* \param[in] float : Altitude in m
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_kalman::update_altitude(float altitude, uint32_t timestamp) {
+  correct(MS5805_KALMAN_VALUE(altitude), timestamp);
+}
+
+/**
+* \brief Predict the estimate with a vertical acceleration measurement.
+*
+* \param[in] float : Vertical acceleration in m/s2, positive upwards, without
+* gravity
+* \param[in] uint32_t : Timestamp in us, from the clock of the pressure samples
+*/
+void ms5805_kalman::update_acceleration(float acceleration,
+                                        uint32_t timestamp) {
+  int32_t elapsed = (int32_t)(timestamp - time);
+
+  if (initialized && elapsed > (int32_t)MS5805_KALMAN_MAX_GAP_US)
+    initialized = false;
+
+  // The previous acceleration holds until now
+  if (initialized && elapsed > 0)
+    predict(timestamp);
+
+  aided = true;
+  this->acceleration = MS5805_KALMAN_VALUE(acceleration);
+}
+
+/**
+* \brief Estimated altitude in m, at the time of the last update.
+*/
+float ms5805_kalman::get_altitude(void) {
+  return MS5805_KALMAN_TO_FLOAT(altitude);
+}
+
+/**
+* \brief Estimated vertical speed in m/s, positive upwards.
+*/
+float ms5805_kalman::get_velocity(void) {
+  return MS5805_KALMAN_TO_FLOAT(velocity);
+}
+
+/**
+* \brief Estimated accelerometer bias in m/s2, 0 without accelerometer.
+*/
+float ms5805_kalman::get_acceleration_bias(void) {
+  return MS5805_KALMAN_TO_FLOAT(bias);
+}
+
+/**
+* \brief Start from a measurement, with a null vertical speed.
+*
+* \param[in] ms5805_kalman_value : Measured altitude
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_kalman::initialize(ms5805_kalman_value measurement,
+                               uint32_t timestamp) {
+  initialized = true;
+  time = timestamp;
+  altitude = measurement;
+  velocity = 0;
+  bias = 0;
+  p00 = altitude_variance;
+  p01 = 0;
+  p02 = 0;
+  p11 = MS5805_KALMAN_VARIANCE(MS5805_KALMAN_INITIAL_VELOCITY_VARIANCE);
+  p12 = 0;
+  p22 = MS5805_KALMAN_VARIANCE(MS5805_KALMAN_INITIAL_BIAS_VARIANCE);
+}
+
+/**
+* \brief Move the state and its covariance forward to a timestamp, holding the
+* last acceleration.
+*
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_kalman::predict(uint32_t timestamp) {
+  ms5805_kalman_variance dt = MS5805_KALMAN_SECONDS(timestamp - time);
+  ms5805_kalman_variance dt2 = MS5805_KALMAN_MUL(dt, dt);
+  ms5805_kalman_variance q, c = 0, d = 0;
+  ms5805_kalman_value a;
+
+  time = timestamp;
+
+  // Without accelerometer, the acceleration is the process noise and the
+  // bias is left out of the model
+  if (aided) {
+    a = acceleration - bias;
+    altitude += MS5805_KALMAN_MUL(dt, velocity) +
+                MS5805_KALMAN_MUL(dt2, a) / 2;
+    velocity += MS5805_KALMAN_MUL(dt, a);
+    c = -dt2 / 2;
+    d = -dt;
+    q = accelerometer_variance;
+  } else {
+    altitude += MS5805_KALMAN_MUL(dt, velocity);
+    q = acceleration_variance;
+  }
+
+  // P = F P F' + Q, with F = [1 dt c; 0 1 d; 0 0 1] where c = -dt^2/2 and
+  // d = -dt are the effects of the bias, and Q the covariance of a white
+  // acceleration, q [dt^4/4 dt^3/2 0; dt^3/2 dt^2 0; 0 0 0], plus the bias
+  // random walk
+  p00 += 2 * MS5805_KALMAN_MUL(dt, p01) + 2 * MS5805_KALMAN_MUL(c, p02) +
+         MS5805_KALMAN_MUL(dt2, p11) +
+         2 * MS5805_KALMAN_MUL(MS5805_KALMAN_MUL(c, dt), p12) +
+         MS5805_KALMAN_MUL(MS5805_KALMAN_MUL(c, c), p22) +
+         MS5805_KALMAN_MUL(MS5805_KALMAN_MUL(dt2, dt2), q) / 4;
+  p01 += MS5805_KALMAN_MUL(dt, p11) + MS5805_KALMAN_MUL(c, p12) +
+         MS5805_KALMAN_MUL(d, p02 + MS5805_KALMAN_MUL(dt, p12) +
+                                  MS5805_KALMAN_MUL(c, p22)) +
+         MS5805_KALMAN_MUL(MS5805_KALMAN_MUL(dt2, dt), q) / 2;
+  p02 += MS5805_KALMAN_MUL(dt, p12) + MS5805_KALMAN_MUL(c, p22);
+  p11 += 2 * MS5805_KALMAN_MUL(d, p12) +
+         MS5805_KALMAN_MUL(MS5805_KALMAN_MUL(d, d), p22) +
+         MS5805_KALMAN_MUL(dt2, q);
+  p12 += MS5805_KALMAN_MUL(d, p22);
+  if (aided)
+    p22 += MS5805_KALMAN_MUL(dt, bias_variance);
+}
+
+/**
+* \brief Predict the state to the time of a measurement, and correct it with
+* the measurement.
+*
+* \param[in] ms5805_kalman_value : Measured altitude
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_kalman::correct(ms5805_kalman_value measurement,
+                            uint32_t timestamp) {
+  int32_t elapsed = (int32_t)(timestamp - time);
+  ms5805_kalman_variance s, k0, k1, k2, old01, old02;
+  ms5805_kalman_value innovation;
+
+  if (!initialized || elapsed > (int32_t)MS5805_KALMAN_MAX_GAP_US ||
+      elapsed < -(int32_t)MS5805_KALMAN_MAX_GAP_US) {
+    initialize(measurement, timestamp);
+    return;
+  }
+
+  if (elapsed >= 0)
+    predict(timestamp);
+  else
+    // Measurement older than the accelerometer updates : bring it forward
+    measurement += MS5805_KALMAN_MUL(MS5805_KALMAN_SECONDS(-elapsed), velocity);
+
+  innovation = measurement - altitude;
+  s = p00 + altitude_variance;
+  k0 = MS5805_KALMAN_DIV(p00, s);
+  k1 = MS5805_KALMAN_DIV(p01, s);
+  k2 = MS5805_KALMAN_DIV(p02, s);
+
+  altitude += MS5805_KALMAN_MUL(k0, innovation);
+  velocity += MS5805_KALMAN_MUL(k1, innovation);
+  if (aided)
+    bias += MS5805_KALMAN_MUL(k2, innovation);
+
+  // P = (I - K H) P, with H = [1 0 0]
+  old01 = p01;
+  old02 = p02;
+  p22 -= MS5805_KALMAN_MUL(k2, old02);
+  p12 -= MS5805_KALMAN_MUL(k1, old02);
+  p11 -= MS5805_KALMAN_MUL(k1, old01);
+  p02 -= MS5805_KALMAN_MUL(k0, old02);
+  p01 -= MS5805_KALMAN_MUL(k0, old01);
+  p00 -= MS5805_KALMAN_MUL(k0, p00);
+}
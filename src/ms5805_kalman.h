@@ -0,0 +1,160 @@
+#ifndef MS5805_KALMAN_H
+#define MS5805_KALMAN_H
+
+#include "ms5805_altitude.h"
+#include "ms5805_config.h"
+#include "ms5805_stage.h"
+
+// Longest time between samples, after which the filter restarts from the
+// next measurement
+#define MS5805_KALMAN_MAX_GAP_US 5000000UL
+
+#ifdef MS5805_KALMAN_FIXED_POINT
+// Altitude and velocity in Q16.16, variances, gains and time in Q12.20
+typedef int32_t ms5805_kalman_value;
+typedef int32_t ms5805_kalman_variance;
+#else
+typedef float ms5805_kalman_value;
+typedef float ms5805_kalman_variance;
+#endif
+
+/**
+ * \brief Kalman filter estimating altitude and vertical speed from pressure
+ * samples and their timestamps, optionally aided by an accelerometer.
+ *
+ * The state is the altitude, the vertical speed and the accelerometer bias.
+ * Without accelerometer, the vertical acceleration is modeled as white noise
+ * and the bias is not used. Once update_acceleration() is called, the
+ * measured acceleration drives the prediction between pressure samples, so
+ * the estimate reacts within one accelerometer sample, and pressure samples
+ * correct the drift and estimate the bias.
+ *
+ * Updates may come at any rate : each one predicts the state to its
+ * timestamp, holding the last acceleration, before applying it. A pressure
+ * sample older than the last update, which happens as samples are stamped at
+ * the start of their conversions, is moved forward with the estimated
+ * speed. As a stage, the filter leaves samples unchanged, so it can be placed
+ * anywhere in a pipeline or behind a dispatcher.
+ */
+class ms5805_kalman : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] float : Process noise, standard deviation of the vertical
+   * acceleration in m/s2
+   * \param[in] float : Measurement noise, standard deviation of the
+   * barometric altitude in m
+   */
+  ms5805_kalman(float acceleration_noise = 1.0f, float altitude_noise = 0.5f);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Set the process noise : larger values follow altitude changes
+   * faster, smaller values smooth more.
+   *
+   * \param[in] float : Standard deviation of the vertical acceleration in
+   * m/s2
+   */
+  void set_process_noise(float acceleration_noise);
+
+  /**
+   * \brief Set the accelerometer noise, used instead of the process noise
+   * once accelerations are given.
+   *
+   * \param[in] float : Standard deviation of the acceleration in m/s2
+   * \param[in] float : Bias random walk in m/s2 per square root of s
+   */
+  void set_accelerometer_noise(float acceleration_noise, float bias_noise);
+
+  /**
+   * \brief Set the measurement noise.
+   *
+   * \param[in] float : Standard deviation of the barometric altitude in m
+   */
+  void set_measurement_noise(float altitude_noise);
+
+  /**
+   * \brief Set the pressure of the altitude reference, 1013.25 mbar by
+   * default.
+   *
+   * \param[in] float : Reference pressure in mbar
+   */
+  void set_reference_pressure(float pressure);
+
+  /**
+   * \brief Set the altitude reference, for instance the one of a sensor
+   * calibrated with ms5805::calibrate_qnh().
+   *
+   * \param[in] ms5805_altitude_reference* : Reference, copied
+   */
+  void
+  set_altitude_reference(const struct ms5805_altitude_reference *reference);
+
+  /**
+   * \brief Correct the estimate with a pressure measurement.
+   *
+   * \param[in] int32_t : Pressure in 0.01 mbar
+   * \param[in] uint32_t : Timestamp in us
+   */
+  void update_pressure(int32_t pressure, uint32_t timestamp);
+
+  /**
+   * \brief Correct the estimate with an altitude measurement.
+   *
+   * \param[in] float : Altitude in m
+   * \param[in] uint32_t : Timestamp in us
+   */
+  void update_altitude(float altitude, uint32_t timestamp);
+
+  /**
+   * \brief Predict the estimate with a vertical acceleration measurement.
+   *
+   * \param[in] float : Vertical acceleration in m/s2, positive upwards,
+   * without gravity
+   * \param[in] uint32_t : Timestamp in us, from the clock of the pressure
+   * samples
+   */
+  void update_acceleration(float acceleration, uint32_t timestamp);
+
+  /**
+   * \brief Estimated altitude in m, at the time of the last update.
+   */
+  float get_altitude(void);
+
+  /**
+   * \brief Estimated vertical speed in m/s, positive upwards.
+   */
+  float get_velocity(void);
+
+  /**
+   * \brief Estimated accelerometer bias in m/s2, 0 without accelerometer.
+   */
+  float get_acceleration_bias(void);
+
+private:
+  void initialize(ms5805_kalman_value measurement, uint32_t timestamp);
+  void predict(uint32_t timestamp);
+  void correct(ms5805_kalman_value measurement, uint32_t timestamp);
+
+  ms5805_kalman_variance acceleration_variance;
+  ms5805_kalman_variance accelerometer_variance;
+  ms5805_kalman_variance bias_variance;
+  ms5805_kalman_variance altitude_variance;
+  struct ms5805_altitude_reference reference;
+
+  bool initialized;
+  bool aided;
+  uint32_t time;
+  ms5805_kalman_value acceleration;
+  ms5805_kalman_value altitude;
+  ms5805_kalman_value velocity;
+  ms5805_kalman_value bias;
+  // Symmetric covariance matrix
+  ms5805_kalman_variance p00, p01, p02, p11, p12, p22;
+};
+
+#endif
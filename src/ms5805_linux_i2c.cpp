@@ -0,0 +1,396 @@
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "ms5805_linux_i2c.h"
+
+// MS5805 device commands
+#define MS5805_READ_ADC 0x00
+
+// Multiplexer control byte enabling no channel
+static uint8_t ms5805_mux_no_channel = 0;
+
+static int system_ioctl(int fd, unsigned long request, void *arg) {
+  return ioctl(fd, request, arg);
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_ioctl_function : ioctl implementation, NULL for the
+* system one
+*/
+ms5805_linux_i2c_bus::ms5805_linux_i2c_bus(
+    ms5805_ioctl_function ioctl_function)
+    : ioctl_function(ioctl_function ? ioctl_function : system_ioctl), fd(-1),
+      owned(false), mux(false), mux_address(0), mux_selection(0) {}
+
+/**
+* \brief Class destructor
+*/
+ms5805_linux_i2c_bus::~ms5805_linux_i2c_bus() { close(); }
+
+/**
+* \brief Open an I2C adapter.
+*
+* \param[in] char* : Adapter path, e.g. "/dev/i2c-1"
+*
+* \return bool : false if the adapter cannot be opened, see errno
+*/
+bool ms5805_linux_i2c_bus::open(const char *path) {
+  int new_fd = ::open(path, O_RDWR | O_CLOEXEC);
+
+  if (new_fd < 0)
+    return false;
+
+  close();
+  fd = new_fd;
+  owned = true;
+
+  return true;
+}
+
+/**
+* \brief Use an already opened adapter, or a fake descriptor. The bus does not
+* take ownership of it.
+*
+* \param[in] int : File descriptor
+*/
+void ms5805_linux_i2c_bus::attach(int fd) {
+  close();
+  this->fd = fd;
+  owned = false;
+}
+
+/**
+* \brief Close the adapter opened by open().
+*/
+void ms5805_linux_i2c_bus::close(void) {
+  if (owned && fd >= 0)
+    ::close(fd);
+  fd = -1;
+  owned = false;
+}
+
+/**
+* \brief File descriptor of the adapter, -1 if none.
+*/
+int ms5805_linux_i2c_bus::get_fd(void) { return fd; }
+
+/**
+* \brief Reach the device behind an I2C multiplexer (TCA9548A type). The
+* channel is selected at the start of every request, and released at its end.
+*
+* \param[in] uint8_t : Multiplexer address, up to 0x7F
+* \param[in] uint8_t : Channel of the device, 0 to 7
+*
+* \return bool : false if the address or the channel is out of range
+*/
+bool ms5805_linux_i2c_bus::set_mux(uint8_t address, uint8_t channel) {
+  if (address > 0x7F || channel > 7)
+    return false;
+
+  mux = true;
+  mux_address = address;
+  mux_selection = 1 << channel;
+
+  return true;
+}
+
+/**
+* \brief Fill the message selecting the multiplexer channel, if any.
+*
+* \param[out] i2c_msg* : Message to fill
+*
+* \return uint32_t : Number of messages filled, 0 or 1
+*/
+uint32_t ms5805_linux_i2c_bus::add_mux_message(struct i2c_msg *message) {
+  if (!mux)
+    return 0;
+
+  message->addr = mux_address;
+  message->flags = 0;
+  message->len = 1;
+  message->buf = &mux_selection;
+
+  return 1;
+}
+
+/**
+* \brief Fill the message releasing the multiplexer channel, if any, so that
+* devices behind other channels or multiplexers can be reached alone.
+*
+* \param[out] i2c_msg* : Message to fill
+*
+* \return uint32_t : Number of messages filled, 0 or 1
+*/
+uint32_t ms5805_linux_i2c_bus::add_mux_release(struct i2c_msg *message) {
+  if (!mux)
+    return 0;
+
+  message->addr = mux_address;
+  message->flags = 0;
+  message->len = 1;
+  message->buf = &ms5805_mux_no_channel;
+
+  return 1;
+}
+
+/**
+* \brief Issue I2C messages in a single I2C_RDWR request.
+*
+* \param[in] i2c_msg* : Messages, with repeated starts in between
+* \param[in] uint32_t : Number of messages
+*
+* \return ms5805_status : status of the transfer
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_linux_i2c_bus::transfer(struct i2c_msg *messages,
+                                                  uint32_t count) {
+  struct i2c_rdwr_ioctl_data request;
+  int result;
+
+  if (fd < 0)
+    return ms5805_status_i2c_transfer_error;
+
+  request.msgs = messages;
+  request.nmsgs = count;
+  do {
+    result = ioctl_function(fd, I2C_RDWR, &request);
+  } while (result < 0 && errno == EINTR);
+
+  // Adapters report a missing acknowledge as ENXIO or EREMOTEIO
+  if (result < 0 && (errno == ENXIO || errno == EREMOTEIO))
+    return ms5805_status_no_i2c_acknowledge;
+  if (result != (int)count)
+    return ms5805_status_i2c_transfer_error;
+
+  return ms5805_status_ok;
+}
+
+/**
+* \brief Write bytes to a device.
+*
+* \param[in] uint8_t : 7-bits device address
+* \param[in] uint8_t* : Bytes to write
+* \param[in] uint8_t : Number of bytes, 0 only checks the acknowledge
+*
+* \return ms5805_status : status of the transfer
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_linux_i2c_bus::write(uint8_t address,
+                                               const uint8_t *data,
+                                               uint8_t length) {
+  struct i2c_msg messages[3];
+  uint32_t count = add_mux_message(messages);
+  enum ms5805_status status;
+
+  messages[count].addr = address;
+  messages[count].flags = 0;
+  messages[count].len = length;
+  messages[count].buf = (uint8_t *)data;
+  count++;
+  count += add_mux_release(messages + count);
+
+  MS5805_BUS_TIMING_CLEAR();
+  MS5805_BUS_TIMING_START(start);
+  status = transfer(messages, count);
+  MS5805_BUS_TIMING_PHASE(write, start);
+
+  return status;
+}
+
+/**
+* \brief Write bytes to a device then read its answer, in a single request
+* with a repeated start.
+*
+* \param[in] uint8_t : 7-bits device address
+* \param[in] uint8_t* : Bytes to write
+* \param[in] uint8_t : Number of bytes to write
+* \param[out] uint8_t* : Bytes read
+* \param[in] uint8_t : Number of bytes to read
+*
+* \return ms5805_status : status of the transfer
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_linux_i2c_bus::write_read(uint8_t address,
+                                                    const uint8_t *data,
+                                                    uint8_t length,
+                                                    uint8_t *buffer,
+                                                    uint8_t size) {
+  struct i2c_msg messages[4];
+  uint32_t count = add_mux_message(messages);
+  enum ms5805_status status;
+
+  messages[count].addr = address;
+  messages[count].flags = 0;
+  messages[count].len = length;
+  messages[count].buf = (uint8_t *)data;
+  messages[count + 1].addr = address;
+  messages[count + 1].flags = I2C_M_RD;
+  messages[count + 1].len = size;
+  messages[count + 1].buf = buffer;
+  count += 2;
+  count += add_mux_release(messages + count);
+
+  // The kernel issues both in one request : all of it counts as the read
+  MS5805_BUS_TIMING_CLEAR();
+  MS5805_BUS_TIMING_START(start);
+  status = transfer(messages, count);
+  MS5805_BUS_TIMING_PHASE(read, start);
+
+  return status;
+}
+
+/**
+* \brief Class constructor
+*/
+ms5805_linux_i2c_batch::ms5805_linux_i2c_batch()
+    : message_count(0), operation_count(0), adapter(NULL), selected(NULL) {}
+
+/**
+* \brief Make room for an operation and select the multiplexer channel of its
+* device when needed.
+*
+* \param[in] ms5805_linux_i2c_bus& : Bus of the device
+*
+* \return bool : false if the bus is not on the adapter of the batch
+*/
+bool ms5805_linux_i2c_batch::reserve(ms5805_linux_i2c_bus &bus) {
+  if (adapter && adapter->fd != bus.fd)
+    return false;
+
+  // Room for a release, a selection, the operation and the final release
+  if (message_count + 5 > MS5805_LINUX_I2C_BATCH_MESSAGES ||
+      operation_count == MS5805_LINUX_I2C_BATCH_OPERATIONS)
+    submit();
+
+  adapter = &bus;
+  // Another multiplexer, or none, is reached once the previous one released
+  // its channel : devices behind both would answer at the same address
+  if (selected && selected->mux &&
+      (!bus.mux || selected->mux_address != bus.mux_address))
+    message_count += selected->add_mux_release(messages + message_count);
+  // Consecutive operations on the same channel share the selection
+  if (!selected || selected->mux != bus.mux ||
+      selected->mux_address != bus.mux_address ||
+      selected->mux_selection != bus.mux_selection)
+    message_count += bus.add_mux_message(messages + message_count);
+  selected = &bus;
+
+  return true;
+}
+
+/**
+* \brief Add a command, e.g. from ms5805::get_conversion_command.
+*
+* \param[in] ms5805_linux_i2c_bus& : Bus of the device
+* \param[in] uint8_t : Command value
+* \param[out] ms5805_status* : Status of the operation, may be NULL
+*
+* \return bool : false if the bus is not on the adapter of the batch
+*/
+bool ms5805_linux_i2c_batch::add_command(ms5805_linux_i2c_bus &bus,
+                                         uint8_t cmd,
+                                         enum ms5805_status *status) {
+  struct operation *op;
+
+  if (!reserve(bus))
+    return false;
+
+  op = &operations[operation_count++];
+  op->command = cmd;
+  op->adc = NULL;
+  op->status = status;
+
+  messages[message_count].addr = MS5805_ADDR;
+  messages[message_count].flags = 0;
+  messages[message_count].len = 1;
+  messages[message_count].buf = &op->command;
+  message_count++;
+
+  return true;
+}
+
+/**
+* \brief Add the read of a completed conversion.
+*
+* \param[in] ms5805_linux_i2c_bus& : Bus of the device
+* \param[out] uint32_t* : ADC value
+* \param[out] ms5805_status* : Status of the operation, may be NULL
+*
+* \return bool : false if the bus is not on the adapter of the batch
+*/
+bool ms5805_linux_i2c_batch::add_read_adc(ms5805_linux_i2c_bus &bus,
+                                          uint32_t *adc,
+                                          enum ms5805_status *status) {
+  struct operation *op;
+
+  if (!reserve(bus))
+    return false;
+
+  op = &operations[operation_count++];
+  op->command = MS5805_READ_ADC;
+  op->adc = adc;
+  op->status = status;
+
+  messages[message_count].addr = MS5805_ADDR;
+  messages[message_count].flags = 0;
+  messages[message_count].len = 1;
+  messages[message_count].buf = &op->command;
+  messages[message_count + 1].addr = MS5805_ADDR;
+  messages[message_count + 1].flags = I2C_M_RD;
+  messages[message_count + 1].len = 3;
+  messages[message_count + 1].buf = op->buffer;
+  message_count += 2;
+
+  return true;
+}
+
+/**
+* \brief Issue the pending operations and scatter their results. The batch is
+* empty afterwards and can be reused.
+*
+* \return ms5805_status : status of the request, also given to every
+* operation
+*       - ms5805_status_ok : I2C transfer completed successfully
+*       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+*       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+*/
+enum ms5805_status ms5805_linux_i2c_batch::submit(void) {
+  enum ms5805_status status = ms5805_status_ok;
+  struct operation *op;
+  uint32_t i;
+
+  if (message_count) {
+    message_count += selected->add_mux_release(messages + message_count);
+    status = adapter->transfer(messages, message_count);
+  }
+
+  for (i = 0; i < operation_count; i++) {
+    op = &operations[i];
+    if (op->status)
+      *op->status = status;
+    if (op->adc && status == ms5805_status_ok)
+      *op->adc = ((uint32_t)op->buffer[0] << 16) |
+                 ((uint32_t)op->buffer[1] << 8) | op->buffer[2];
+  }
+
+  message_count = 0;
+  operation_count = 0;
+  adapter = NULL;
+  selected = NULL;
+
+  return status;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef MS5805_LINUX_I2C_H
+#define MS5805_LINUX_I2C_H
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+#include "ms5805_bus.h"
+
+/**
+ * \brief Function issuing the ioctl requests of the bus, to substitute a fake
+ * device in tests.
+ */
+typedef int (*ms5805_ioctl_function)(int fd, unsigned long request,
+                                     void *arg);
+
+// Maximum number of messages of a batch, limited by the kernel
+#define MS5805_LINUX_I2C_BATCH_MESSAGES I2C_RDWR_IOCTL_MAX_MSGS
+// Maximum number of operations of a batch, the reads taking 2 messages
+#define MS5805_LINUX_I2C_BATCH_OPERATIONS (MS5805_LINUX_I2C_BATCH_MESSAGES / 2)
+
+/**
+ * \brief Bus reaching the device through a Linux /dev/i2c-N adapter, closed
+ * with the bus when opened by it.
+ *
+ * A write followed by a read is issued as a single I2C_RDWR request with a
+ * repeated start, instead of two separate transfers.
+ *
+ * All MS5805 answer at the same address : a multiplexer channel is only kept
+ * selected during the requests to its device, and released at their end.
+ */
+class ms5805_linux_i2c_bus : public ms5805_bus {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_ioctl_function : ioctl implementation, NULL for the
+   * system one
+   */
+  ms5805_linux_i2c_bus(ms5805_ioctl_function ioctl_function = NULL);
+  ~ms5805_linux_i2c_bus();
+
+  /**
+   * \brief Open an I2C adapter.
+   *
+   * \param[in] char* : Adapter path, e.g. "/dev/i2c-1"
+   *
+   * \return bool : false if the adapter cannot be opened, see errno
+   */
+  bool open(const char *path);
+
+  /**
+   * \brief Use an already opened adapter, or a fake descriptor. The bus
+   * does not take ownership of it.
+   *
+   * \param[in] int : File descriptor
+   */
+  void attach(int fd);
+
+  /**
+   * \brief Close the adapter opened by open().
+   */
+  void close(void);
+
+  /**
+   * \brief File descriptor of the adapter, -1 if none.
+   */
+  int get_fd(void);
+
+  /**
+   * \brief Reach the device behind an I2C multiplexer (TCA9548A type). The
+   * channel is selected at the start of every request, and released at its
+   * end.
+   *
+   * \param[in] uint8_t : Multiplexer address, up to 0x7F
+   * \param[in] uint8_t : Channel of the device, 0 to 7
+   *
+   * \return bool : false if the address or the channel is out of range
+   */
+  bool set_mux(uint8_t address, uint8_t channel);
+
+  enum ms5805_status write(uint8_t address, const uint8_t *data,
+                           uint8_t length);
+  enum ms5805_status write_read(uint8_t address, const uint8_t *data,
+                                uint8_t length, uint8_t *buffer, uint8_t size);
+
+  /**
+   * \brief Issue I2C messages in a single I2C_RDWR request.
+   *
+   * \param[in] i2c_msg* : Messages, with repeated starts in between
+   * \param[in] uint32_t : Number of messages
+   *
+   * \return ms5805_status : status of the transfer
+   *       - ms5805_status_ok : I2C transfer completed successfully
+   *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+   *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+   */
+  enum ms5805_status transfer(struct i2c_msg *messages, uint32_t count);
+
+private:
+  friend class ms5805_linux_i2c_batch;
+
+  // A copy would close the adapter a second time
+  ms5805_linux_i2c_bus(const ms5805_linux_i2c_bus &) = delete;
+  ms5805_linux_i2c_bus &operator=(const ms5805_linux_i2c_bus &) = delete;
+
+  uint32_t add_mux_message(struct i2c_msg *message);
+  uint32_t add_mux_release(struct i2c_msg *message);
+
+  ms5805_ioctl_function ioctl_function;
+  int fd;
+  bool owned;
+  bool mux;
+  uint8_t mux_address;
+  uint8_t mux_selection;
+};
+
+/**
+ * \brief Collects operations on several devices sharing an adapter, possibly
+ * behind multiplexers, and issues them in a single I2C_RDWR request.
+ *
+ * Results are written to the destinations given when adding operations, once
+ * the batch is submitted. A batch that gets full is submitted automatically.
+ * A multiplexer is released before a device behind another one, or behind
+ * none, is reached, and at the end of the request.
+ */
+class ms5805_linux_i2c_batch {
+
+public:
+  ms5805_linux_i2c_batch();
+
+  /**
+   * \brief Add a command, e.g. from ms5805::get_conversion_command.
+   *
+   * \param[in] ms5805_linux_i2c_bus& : Bus of the device
+   * \param[in] uint8_t : Command value
+   * \param[out] ms5805_status* : Status of the operation, may be NULL
+   *
+   * \return bool : false if the bus is not on the adapter of the batch
+   */
+  bool add_command(ms5805_linux_i2c_bus &bus, uint8_t cmd,
+                   enum ms5805_status *status = NULL);
+
+  /**
+   * \brief Add the read of a completed conversion.
+   *
+   * \param[in] ms5805_linux_i2c_bus& : Bus of the device
+   * \param[out] uint32_t* : ADC value
+   * \param[out] ms5805_status* : Status of the operation, may be NULL
+   *
+   * \return bool : false if the bus is not on the adapter of the batch
+   */
+  bool add_read_adc(ms5805_linux_i2c_bus &bus, uint32_t *adc,
+                    enum ms5805_status *status = NULL);
+
+  /**
+   * \brief Issue the pending operations and scatter their results. The
+   * batch is empty afterwards and can be reused.
+   *
+   * \return ms5805_status : status of the request, also given to every
+   * operation
+   *       - ms5805_status_ok : I2C transfer completed successfully
+   *       - ms5805_status_i2c_transfer_error : Problem with i2c transfer
+   *       - ms5805_status_no_i2c_acknowledge : I2C did not acknowledge
+   */
+  enum ms5805_status submit(void);
+
+private:
+  bool reserve(ms5805_linux_i2c_bus &bus);
+
+  struct operation {
+    uint8_t command;
+    uint8_t buffer[3];
+    uint32_t *adc;
+    enum ms5805_status *status;
+  };
+
+  struct i2c_msg messages[MS5805_LINUX_I2C_BATCH_MESSAGES];
+  struct operation operations[MS5805_LINUX_I2C_BATCH_OPERATIONS];
+  uint32_t message_count;
+  uint32_t operation_count;
+  ms5805_linux_i2c_bus *adapter;
+  ms5805_linux_i2c_bus *selected;
+};
+
+#endif
+
+#endif
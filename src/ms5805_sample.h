@@ -0,0 +1,22 @@
+#ifndef MS5805_SAMPLE_H
+#define MS5805_SAMPLE_H
+
+#include <stdint.h>
+
+// Sample flags, set by processing stages
+#define MS5805_SAMPLE_FLAG_OUTLIER 0x01
+
+/**
+ * \brief Compensated measurement, in integer units so that it can be copied,
+ * compared and filtered without floating point.
+ */
+struct ms5805_sample {
+  uint32_t timestamp;       // Start of the acquisition in us, wraps around
+  int32_t temperature;      // 0.01 Celsius Degree
+  int32_t pressure;         // 0.01 mbar
+  uint32_t adc_temperature; // Raw D2 value
+  uint32_t adc_pressure;    // Raw D1 value
+  uint8_t flags;            // MS5805_SAMPLE_FLAG_*
+};
+
+#endif
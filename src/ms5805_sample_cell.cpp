@@ -0,0 +1,75 @@
+#include "ms5805_sample_cell.h"
+
+// Single-core AVR only needs the compiler to keep the accesses in order,
+// other targets may run the writer and the readers on different cores
+#if defined(__AVR__)
+#define MS5805_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define MS5805_MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/**
+* \brief Class constructor
+*/
+ms5805_sample_cell::ms5805_sample_cell() : sequence(0), latest() {}
+
+/**
+* \brief Replace the latest sample. Only one writer is allowed.
+*
+* \param[in] ms5805_sample* : Sample to publish
+*/
+void ms5805_sample_cell::publish(const struct ms5805_sample *sample) {
+  ms5805_sequence_t start = sequence;
+  ms5805_sequence_t end = start + 2;
+
+  // 0 means empty, skip it when the sequence wraps around
+  if (end == 0)
+    end = 2;
+
+  sequence = start + 1;
+  MS5805_MEMORY_BARRIER();
+  latest = *sample;
+  MS5805_MEMORY_BARRIER();
+  sequence = end;
+}
+
+/**
+* \brief Copy the latest sample, retrying until a consistent copy is made.
+* Must not be called from an interrupt handler which may preempt the writer,
+* see try_read().
+*
+* \param[out] ms5805_sample* : Latest sample
+*
+* \return bool : false if nothing was published yet
+*/
+bool ms5805_sample_cell::read(struct ms5805_sample *sample) {
+  if (sequence == 0)
+    return false;
+
+  while (!try_read(sample))
+    ;
+
+  return true;
+}
+
+/**
+* \brief Copy the latest sample with a single attempt, for readers which may
+* preempt the writer and would otherwise spin forever.
+*
+* \param[out] ms5805_sample* : Latest sample
+*
+* \return bool : false if nothing was published yet or if the writer was
+* updating the sample
+*/
+bool ms5805_sample_cell::try_read(struct ms5805_sample *sample) {
+  ms5805_sequence_t start = sequence;
+
+  if (start == 0 || (start & 1))
+    return false;
+
+  MS5805_MEMORY_BARRIER();
+  *sample = latest;
+  MS5805_MEMORY_BARRIER();
+
+  return sequence == start;
+}
@@ -0,0 +1,62 @@
+#ifndef MS5805_SAMPLE_CELL_H
+#define MS5805_SAMPLE_CELL_H
+
+#include "ms5805_sample.h"
+
+// The sequence has to be loaded and stored in a single instruction : 8-bit
+// on AVR, the native word elsewhere
+#if defined(__AVR__)
+typedef uint8_t ms5805_sequence_t;
+#else
+typedef uint32_t ms5805_sequence_t;
+#endif
+
+/**
+ * \brief Latest sample, shared without locks between one writer and any
+ * number of readers (threads, or main loop and interrupt handler).
+ *
+ * The writer makes the sequence odd, copies the sample and makes the sequence
+ * even again, so it never waits. Readers copy the sample and retry when the
+ * sequence was odd or changed meanwhile, so they never see a temperature from
+ * one measurement with the pressure of another.
+ */
+class ms5805_sample_cell {
+
+public:
+  ms5805_sample_cell();
+
+  /**
+   * \brief Replace the latest sample. Only one writer is allowed.
+   *
+   * \param[in] ms5805_sample* : Sample to publish
+   */
+  void publish(const struct ms5805_sample *sample);
+
+  /**
+   * \brief Copy the latest sample, retrying until a consistent copy is made.
+   * Must not be called from an interrupt handler which may preempt the
+   * writer, see try_read().
+   *
+   * \param[out] ms5805_sample* : Latest sample
+   *
+   * \return bool : false if nothing was published yet
+   */
+  bool read(struct ms5805_sample *sample);
+
+  /**
+   * \brief Copy the latest sample with a single attempt, for readers which
+   * may preempt the writer and would otherwise spin forever.
+   *
+   * \param[out] ms5805_sample* : Latest sample
+   *
+   * \return bool : false if nothing was published yet or if the writer was
+   * updating the sample
+   */
+  bool try_read(struct ms5805_sample *sample);
+
+private:
+  volatile ms5805_sequence_t sequence;
+  struct ms5805_sample latest;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <math.h>
+
+#include "ms5805_sampler.h"
+
+/**
+* \brief Class constructor
+*/
+ms5805_jitter_stats::ms5805_jitter_stats() { reset(); }
+
+/**
+* \brief Account for a new timestamp, the period being measured from the
+* previous one.
+*
+* \param[in] uint32_t : Timestamp in us, wrapping around on 32-bits
+*/
+void ms5805_jitter_stats::add(uint32_t timestamp) {
+  uint32_t period = timestamp - last;
+  int32_t difference;
+
+  last = timestamp;
+  if (!started) {
+    started = true;
+    return;
+  }
+
+  if (count == 0) {
+    offset = period;
+    min = period;
+    max = period;
+  }
+  if (period < min)
+    min = period;
+  if (period > max)
+    max = period;
+
+  difference = (int32_t)(period - offset);
+  sum += difference;
+  sum_of_squares += (uint64_t)((int64_t)difference * difference);
+  count++;
+}
+
+/**
+* \brief Forget all timestamps.
+*/
+void ms5805_jitter_stats::reset(void) {
+  last = 0;
+  started = false;
+  count = 0;
+  min = 0;
+  max = 0;
+  offset = 0;
+  sum = 0;
+  sum_of_squares = 0;
+}
+
+/**
+* \brief Number of periods measured.
+*/
+uint32_t ms5805_jitter_stats::get_count(void) { return count; }
+
+/**
+* \brief Shortest period in us, 0 if none measured.
+*/
+uint32_t ms5805_jitter_stats::get_min(void) { return min; }
+
+/**
+* \brief Longest period in us, 0 if none measured.
+*/
+uint32_t ms5805_jitter_stats::get_max(void) { return max; }
+
+/**
+* \brief Mean period in us, 0 if none measured.
+*/
+float ms5805_jitter_stats::get_mean(void) {
+  if (count == 0)
+    return 0;
+
+  return offset + (float)sum / count;
+}
+
+/**
+* \brief Standard deviation of the period in us, 0 if none measured.
+*/
+float ms5805_jitter_stats::get_stddev(void) {
+  float mean, variance;
+
+  if (count == 0)
+    return 0;
+
+  mean = (float)sum / count;
+  variance = (float)sum_of_squares / count - mean * mean;
+
+  return variance > 0 ? sqrtf(variance) : 0;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805& : Sensor, whose clock timestamps the samples
+*/
+ms5805_sampler::ms5805_sampler(ms5805 &sensor)
+    : sensor(&sensor), running(false), ticks_per_sample(0),
+      conversion_ticks(0), tick_count(0), phase_ticks(0), missed(0) {}
+
+/**
+* \brief Set the tick period and the sampling period, and start sampling at the
+* next tick. Has to be called again after a resolution change.
+*
+* \param[in] uint32_t : Tick period in us
+* \param[in] uint16_t : Number of ticks between samples
+*
+* \return bool : false if both conversions do not fit in a sampling period at
+* the current resolution
+*/
+bool ms5805_sampler::start(uint32_t tick_period_us, uint16_t ticks_per_sample) {
+  uint32_t conversion_us = sensor->get_conversion_time() * 1000UL;
+  uint32_t ticks;
+
+  if (tick_period_us == 0)
+    return false;
+
+  // First tick at which a conversion is complete
+  ticks = (conversion_us + tick_period_us - 1) / tick_period_us;
+  if (ticks == 0)
+    ticks = 1;
+
+  if (2 * ticks > ticks_per_sample)
+    return false;
+
+  running = false;
+  this->ticks_per_sample = ticks_per_sample;
+  conversion_ticks = ticks;
+  tick_count = 0;
+  missed = 0;
+  jitter.reset();
+  running = true;
+
+  return true;
+}
+
+/**
+* \brief Stop sampling, after the measurement in progress completes.
+*/
+void ms5805_sampler::stop(void) { running = false; }
+
+/**
+* \brief Advance the acquisition. To be called at every tick, e.g. from a timer
+* interrupt handler.
+*/
+void ms5805_sampler::tick(void) {
+  enum ms5805_status status;
+
+  // Read the conversion first, so that the last one of a sample can complete
+  // on the tick starting the next sample
+  if (sensor->measurement_state != ms5805_measurement_state_idle &&
+      --phase_ticks == 0) {
+    status = sensor->advance_measurement(&sensor->measurement_state,
+                                         &sensor->measurement);
+    if (sensor->measurement_state != ms5805_measurement_state_idle)
+      phase_ticks = conversion_ticks;
+    else
+      sensor->complete_measurement(status);
+  }
+
+  if (!running)
+    return;
+
+  if (tick_count == 0) {
+    status = sensor->begin_measurement(&sensor->measurement_state,
+                                       &sensor->measurement);
+    if (status == ms5805_status_ok) {
+      phase_ticks = conversion_ticks;
+      jitter.add(sensor->measurement.timestamp);
+    } else
+      missed++;
+  }
+
+  if (++tick_count == ticks_per_sample)
+    tick_count = 0;
+}
+
+/**
+* \brief Number of samples which could not be started, because the bus was
+* busy or the device did not answer.
+*/
+uint32_t ms5805_sampler::get_missed(void) { return missed; }
+
+/**
+* \brief Statistics of the period between the starts of samples.
+*/
+ms5805_jitter_stats &ms5805_sampler::get_jitter(void) { return jitter; }
@@ -0,0 +1,132 @@
+#ifndef MS5805_SAMPLER_H
+#define MS5805_SAMPLER_H
+
+#include "ms5805.h"
+
+/**
+ * \brief Statistics of the period between timestamps : minimum, maximum,
+ * mean and standard deviation, accumulated with integers only.
+ */
+class ms5805_jitter_stats {
+
+public:
+  ms5805_jitter_stats();
+
+  /**
+   * \brief Account for a new timestamp, the period being measured from the
+   * previous one.
+   *
+   * \param[in] uint32_t : Timestamp in us, wrapping around on 32-bits
+   */
+  void add(uint32_t timestamp);
+
+  /**
+   * \brief Forget all timestamps.
+   */
+  void reset(void);
+
+  /**
+   * \brief Number of periods measured.
+   */
+  uint32_t get_count(void);
+
+  /**
+   * \brief Shortest period in us, 0 if none measured.
+   */
+  uint32_t get_min(void);
+
+  /**
+   * \brief Longest period in us, 0 if none measured.
+   */
+  uint32_t get_max(void);
+
+  /**
+   * \brief Mean period in us, 0 if none measured.
+   */
+  float get_mean(void);
+
+  /**
+   * \brief Standard deviation of the period in us, 0 if none measured.
+   */
+  float get_stddev(void);
+
+private:
+  uint32_t last;
+  bool started;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  // Sums of the differences to the first period, which keeps the sum of
+  // squares small and precise
+  uint32_t offset;
+  int64_t sum;
+  uint64_t sum_of_squares;
+};
+
+/**
+ * \brief Acquisition paced by a periodic tick, typically a hardware timer
+ * interrupt. Every conversion phase is triggered by a tick, so samples stay
+ * locked to the timer instead of drifting like delay()-paced loops.
+ *
+ * A sample starts every ticks_per_sample ticks. Its temperature conversion is
+ * read, and its pressure conversion started, on the first tick after the
+ * conversion time, and its pressure conversion read the same way. Samples are
+ * then published and reported to the sample callback as in background
+ * measurements.
+ */
+class ms5805_sampler {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805& : Sensor, whose clock timestamps the samples
+   */
+  ms5805_sampler(ms5805 &sensor);
+
+  /**
+   * \brief Set the tick period and the sampling period, and start sampling
+   * at the next tick. Has to be called again after a resolution change.
+   *
+   * \param[in] uint32_t : Tick period in us
+   * \param[in] uint16_t : Number of ticks between samples
+   *
+   * \return bool : false if both conversions do not fit in a sampling
+   * period at the current resolution
+   */
+  bool start(uint32_t tick_period_us, uint16_t ticks_per_sample);
+
+  /**
+   * \brief Stop sampling, after the measurement in progress completes.
+   */
+  void stop(void);
+
+  /**
+   * \brief Advance the acquisition. To be called at every tick, e.g. from a
+   * timer interrupt handler.
+   */
+  void tick(void);
+
+  /**
+   * \brief Number of samples which could not be started, because the bus
+   * was busy or the device did not answer.
+   */
+  uint32_t get_missed(void);
+
+  /**
+   * \brief Statistics of the period between the starts of samples.
+   */
+  ms5805_jitter_stats &get_jitter(void);
+
+private:
+  ms5805 *sensor;
+  volatile bool running;
+  uint16_t ticks_per_sample;
+  uint16_t conversion_ticks;
+  uint16_t tick_count;
+  uint16_t phase_ticks;
+  uint32_t missed;
+  ms5805_jitter_stats jitter;
+};
+
+#endif
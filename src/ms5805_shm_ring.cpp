@@ -0,0 +1,294 @@
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ms5805_shm_ring.h"
+
+// Attempts at copying a slot before giving up on a writer which stopped in
+// the middle of a write
+#define MS5805_RING_READ_ATTEMPTS 65536
+
+/**
+* \brief Class constructor
+*/
+ms5805_shm_ring_writer::ms5805_shm_ring_writer()
+    : header(NULL), slots(NULL), size(0) {}
+
+/**
+* \brief Class destructor
+*/
+ms5805_shm_ring_writer::~ms5805_shm_ring_writer() { close(); }
+
+/**
+* \brief Create, or replace, a shared-memory ring. A ring of the same name is
+* unlinked, readers keep their mapping of it.
+*
+* \param[in] char* : POSIX shared memory name, e.g. "/ms5805"
+* \param[in] uint32_t : Number of records kept
+*
+* \return bool : false if the ring cannot be created, see errno
+*/
+bool ms5805_shm_ring_writer::create(const char *name, uint32_t capacity) {
+  void *map;
+  int fd;
+
+  close();
+  if (capacity == 0)
+    return false;
+
+  // Resizing the existing object would fault the readers mapping it : they
+  // keep it, and the new ring starts zeroed in a new object
+  if (shm_unlink(name) != 0 && errno != ENOENT)
+    return false;
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+
+  size = sizeof(struct ms5805_ring_header) +
+         (size_t)capacity * sizeof(struct ms5805_ring_slot);
+  if (ftruncate(fd, size) != 0) {
+    ::close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  header = (struct ms5805_ring_header *)map;
+  slots = (struct ms5805_ring_slot *)(header + 1);
+  header->version = MS5805_RING_VERSION;
+  header->capacity = capacity;
+  header->slot_size = sizeof(struct ms5805_ring_slot);
+  header->head = 0;
+  // Readers check the magic last
+  __atomic_store_n(&header->magic, MS5805_RING_MAGIC, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+/**
+* \brief Publish a record. Never blocks, the oldest record is overwritten.
+*
+* \param[in] ms5805_ring_record* : Record to publish
+*/
+void ms5805_shm_ring_writer::publish(const struct ms5805_ring_record *record) {
+  uint64_t index = header->head;
+  struct ms5805_ring_slot *slot = &slots[index % header->capacity];
+  uint32_t sequence = slot->sequence;
+
+  __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->index = index;
+  slot->record = *record;
+  __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&header->head, index + 1, __ATOMIC_RELEASE);
+}
+
+/**
+* \brief Unmap the ring. The shared memory stays available to readers.
+*/
+void ms5805_shm_ring_writer::close(void) {
+  if (header)
+    munmap(header, size);
+  header = NULL;
+  slots = NULL;
+}
+
+/**
+* \brief Class constructor
+*/
+ms5805_shm_ring_reader::ms5805_shm_ring_reader()
+    : header(NULL), slots(NULL), size(0), device(0), inode(0) {
+  name[0] = '\0';
+}
+
+/**
+* \brief Class destructor
+*/
+ms5805_shm_ring_reader::~ms5805_shm_ring_reader() { close(); }
+
+/**
+* \brief Map an existing ring.
+*
+* \param[in] char* : POSIX shared memory name, e.g. "/ms5805"
+*
+* \return bool : false if the ring does not exist or is not compatible
+*/
+bool ms5805_shm_ring_reader::open(const char *name) {
+  struct stat st;
+  void *map;
+  int fd;
+
+  close();
+  fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0)
+    return false;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct ms5805_ring_header)) {
+    ::close(fd);
+    return false;
+  }
+  size = st.st_size;
+  device = st.st_dev;
+  inode = st.st_ino;
+  strncpy(this->name, name, sizeof(this->name) - 1);
+  this->name[sizeof(this->name) - 1] = '\0';
+  map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  header = (const struct ms5805_ring_header *)map;
+  slots = (const struct ms5805_ring_slot *)(header + 1);
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != MS5805_RING_MAGIC ||
+      header->version != MS5805_RING_VERSION ||
+      header->slot_size != sizeof(struct ms5805_ring_slot) ||
+      header->capacity == 0 ||
+      size < sizeof(struct ms5805_ring_header) +
+                 (size_t)header->capacity * sizeof(struct ms5805_ring_slot)) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+/**
+* \brief Copy a record, retrying while the writer is updating its slot.
+*
+* \param[in] uint64_t : Index of the record
+* \param[out] ms5805_ring_record* : Record
+*
+* \return ms5805_ring_result
+*       - ms5805_ring_ok : Record copied
+*       - ms5805_ring_overrun : The record was overwritten by a newer one
+*       - ms5805_ring_busy : The slot stayed locked, the writer may have died
+* in the middle of a write
+*/
+enum ms5805_ring_result
+ms5805_shm_ring_reader::read_slot(uint64_t index,
+                                  struct ms5805_ring_record *record) {
+  const struct ms5805_ring_slot *slot = &slots[index % header->capacity];
+  uint32_t before, after, attempt;
+  uint64_t slot_index;
+
+  for (attempt = 0; attempt < MS5805_RING_READ_ATTEMPTS; attempt++) {
+    before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (before & 1)
+      continue;
+    slot_index = slot->index;
+    *record = slot->record;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    if (before == after)
+      return slot_index == index ? ms5805_ring_ok : ms5805_ring_overrun;
+  }
+
+  return ms5805_ring_busy;
+}
+
+/**
+* \brief Copy the most recent record.
+*
+* \param[out] ms5805_ring_record* : Record
+*
+* \return ms5805_ring_result
+*       - ms5805_ring_ok : Record copied
+*       - ms5805_ring_empty : Nothing published yet
+*       - ms5805_ring_busy : The writer stopped in the middle of a write
+*/
+enum ms5805_ring_result
+ms5805_shm_ring_reader::read_latest(struct ms5805_ring_record *record) {
+  enum ms5805_ring_result result;
+  uint64_t head;
+
+  do {
+    head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (head == 0)
+      return ms5805_ring_empty;
+    result = read_slot(head - 1, record);
+  } while (result == ms5805_ring_overrun);
+
+  return result;
+}
+
+/**
+* \brief Copy the record following a cursor, to consume every record.
+*
+* \param[in,out] uint64_t* : Index of the next record to read, 0 initially
+* \param[out] ms5805_ring_record* : Record
+*
+* \return ms5805_ring_result
+*       - ms5805_ring_ok : Record copied and cursor advanced
+*       - ms5805_ring_empty : No new record
+*       - ms5805_ring_overrun : Records were overwritten before being read,
+* the cursor is moved to the oldest record available
+*       - ms5805_ring_busy : The writer stopped in the middle of a write, the
+* cursor is unchanged
+*/
+enum ms5805_ring_result
+ms5805_shm_ring_reader::read_next(uint64_t *cursor,
+                                  struct ms5805_ring_record *record) {
+  uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+  enum ms5805_ring_result result = ms5805_ring_overrun;
+
+  if (*cursor >= head)
+    return ms5805_ring_empty;
+
+  if (head - *cursor <= header->capacity)
+    result = read_slot(*cursor, record);
+  if (result == ms5805_ring_busy)
+    return result;
+  if (result == ms5805_ring_overrun) {
+    // Leave one slot of margin for the record being written
+    head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    *cursor = head > header->capacity ? head - header->capacity + 1 : 0;
+    return ms5805_ring_overrun;
+  }
+  (*cursor)++;
+
+  return ms5805_ring_ok;
+}
+
+/**
+* \brief Check whether a writer created a new ring under the name, which is
+* then to be opened again.
+*
+* \return bool : true if the mapped ring was replaced or removed
+*/
+bool ms5805_shm_ring_reader::is_replaced(void) {
+  struct stat st;
+  int fd;
+
+  if (!header)
+    return false;
+  fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0)
+    return true;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return true;
+  }
+  ::close(fd);
+
+  return (uint64_t)st.st_dev != device || (uint64_t)st.st_ino != inode;
+}
+
+/**
+* \brief Unmap the ring.
+*/
+void ms5805_shm_ring_reader::close(void) {
+  if (header)
+    munmap((void *)header, size);
+  header = NULL;
+  slots = NULL;
+}
+
+#endif
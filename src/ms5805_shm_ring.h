@@ -0,0 +1,167 @@
+#ifndef MS5805_SHM_RING_H
+#define MS5805_SHM_RING_H
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Shared-memory sample ring : one acquisition process publishes samples, any
+ * number of processes map the ring read-only and read them without locks and
+ * without touching the bus.
+ *
+ * Every slot is protected by its own sequence counter, odd while the slot is
+ * being written. Readers copy a slot and retry if the counter changed.
+ *
+ * A restarted writer creates a new shared memory object under the same name,
+ * so that readers still mapping the previous one are not affected. They
+ * notice it with is_replaced() and open the ring again.
+ */
+#define MS5805_RING_MAGIC 0x4D35524EUL // "M5RN"
+#define MS5805_RING_VERSION 1
+
+struct ms5805_ring_record {
+  uint64_t timestamp_ns; // CLOCK_MONOTONIC
+  uint32_t sensor;
+  int32_t temperature; // 0.01 Celsius Degree
+  int32_t pressure;    // 0.01 mbar
+  int32_t status;      // ms5805_status
+};
+
+struct ms5805_ring_slot {
+  uint32_t sequence;
+  uint32_t reserved;
+  uint64_t index;
+  struct ms5805_ring_record record;
+};
+
+struct ms5805_ring_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t slot_size;
+  uint64_t head; // Number of records published
+  uint8_t reserved[40];
+};
+
+enum ms5805_ring_result {
+  ms5805_ring_ok,
+  ms5805_ring_empty,
+  ms5805_ring_overrun,
+  ms5805_ring_busy
+};
+
+/**
+ * \brief Publishing side of the ring. There must be a single writer.
+ */
+class ms5805_shm_ring_writer {
+
+public:
+  ms5805_shm_ring_writer();
+  ~ms5805_shm_ring_writer();
+
+  /**
+   * \brief Create, or replace, a shared-memory ring. A ring of the same name
+   * is unlinked, readers keep their mapping of it.
+   *
+   * \param[in] char* : POSIX shared memory name, e.g. "/ms5805"
+   * \param[in] uint32_t : Number of records kept
+   *
+   * \return bool : false if the ring cannot be created, see errno
+   */
+  bool create(const char *name, uint32_t capacity);
+
+  /**
+   * \brief Publish a record. Never blocks, the oldest record is overwritten.
+   *
+   * \param[in] ms5805_ring_record* : Record to publish
+   */
+  void publish(const struct ms5805_ring_record *record);
+
+  /**
+   * \brief Unmap the ring. The shared memory stays available to readers.
+   */
+  void close(void);
+
+private:
+  struct ms5805_ring_header *header;
+  struct ms5805_ring_slot *slots;
+  size_t size;
+};
+
+/**
+ * \brief Reading side of the ring, mapped read-only.
+ */
+class ms5805_shm_ring_reader {
+
+public:
+  ms5805_shm_ring_reader();
+  ~ms5805_shm_ring_reader();
+
+  /**
+   * \brief Map an existing ring.
+   *
+   * \param[in] char* : POSIX shared memory name, e.g. "/ms5805"
+   *
+   * \return bool : false if the ring does not exist or is not compatible
+   */
+  bool open(const char *name);
+
+  /**
+   * \brief Copy the most recent record.
+   *
+   * \param[out] ms5805_ring_record* : Record
+   *
+   * \return ms5805_ring_result
+   *       - ms5805_ring_ok : Record copied
+   *       - ms5805_ring_empty : Nothing published yet
+   *       - ms5805_ring_busy : The writer stopped in the middle of a write
+   */
+  enum ms5805_ring_result read_latest(struct ms5805_ring_record *record);
+
+  /**
+   * \brief Copy the record following a cursor, to consume every record.
+   *
+   * \param[in,out] uint64_t* : Index of the next record to read, 0 initially
+   * \param[out] ms5805_ring_record* : Record
+   *
+   * \return ms5805_ring_result
+   *       - ms5805_ring_ok : Record copied and cursor advanced
+   *       - ms5805_ring_empty : No new record
+   *       - ms5805_ring_overrun : Records were overwritten before being read,
+   * the cursor is moved to the oldest record available
+   *       - ms5805_ring_busy : The writer stopped in the middle of a write,
+   * the cursor is unchanged
+   */
+  enum ms5805_ring_result read_next(uint64_t *cursor,
+                                    struct ms5805_ring_record *record);
+
+  /**
+   * \brief Check whether a writer created a new ring under the name, which
+   * is then to be opened again.
+   *
+   * \return bool : true if the mapped ring was replaced or removed
+   */
+  bool is_replaced(void);
+
+  /**
+   * \brief Unmap the ring.
+   */
+  void close(void);
+
+private:
+  enum ms5805_ring_result read_slot(uint64_t index,
+                                    struct ms5805_ring_record *record);
+
+  const struct ms5805_ring_header *header;
+  const struct ms5805_ring_slot *slots;
+  size_t size;
+  char name[256];
+  uint64_t device;
+  uint64_t inode;
+};
+
+#endif
+
+#endif
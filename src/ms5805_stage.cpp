@@ -0,0 +1,103 @@
+#include <stddef.h>
+
+#include "ms5805_stage.h"
+
+/**
+* \brief Value of a sample field. ADC values are 24-bits and fit.
+*
+* \param[in] ms5805_sample* : Sample
+* \param[in] ms5805_sample_field : Field
+*
+* \return int32_t : Value
+*/
+int32_t ms5805_get_field(const struct ms5805_sample *sample,
+                         enum ms5805_sample_field field) {
+  switch (field) {
+  case ms5805_sample_field_temperature:
+    return sample->temperature;
+  case ms5805_sample_field_pressure:
+    return sample->pressure;
+  case ms5805_sample_field_adc_temperature:
+    return (int32_t)sample->adc_temperature;
+  case ms5805_sample_field_adc_pressure:
+    return (int32_t)sample->adc_pressure;
+  default:
+    return 0;
+  }
+}
+
+/**
+* \brief Change a sample field.
+*
+* \param[in,out] ms5805_sample* : Sample
+* \param[in] ms5805_sample_field : Field
+* \param[in] int32_t : Value
+*/
+void ms5805_set_field(struct ms5805_sample *sample,
+                      enum ms5805_sample_field field, int32_t value) {
+  switch (field) {
+  case ms5805_sample_field_temperature:
+    sample->temperature = value;
+    break;
+  case ms5805_sample_field_pressure:
+    sample->pressure = value;
+    break;
+  case ms5805_sample_field_adc_temperature:
+    sample->adc_temperature = (uint32_t)value;
+    break;
+  case ms5805_sample_field_adc_pressure:
+    sample->adc_pressure = (uint32_t)value;
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+* \brief Class constructor
+*/
+ms5805_stage::ms5805_stage() : next(NULL) {}
+
+/**
+* \brief Forget the samples seen so far.
+*/
+void ms5805_stage::reset(void) {}
+
+/**
+* \brief Set the stage receiving the output of this one.
+*
+* \param[in] ms5805_stage* : Next stage, NULL to end the pipeline
+*
+* \return ms5805_stage* : Next stage, to chain calls
+*/
+ms5805_stage *ms5805_stage::set_next(ms5805_stage *next) {
+  this->next = next;
+  return next;
+}
+
+/**
+* \brief Process a sample through this stage and all the following ones.
+*
+* \param[in,out] ms5805_sample* : Sample
+*
+* \return bool : false if a stage dropped the sample
+*/
+bool ms5805_stage::run(struct ms5805_sample *sample) {
+  ms5805_stage *stage;
+
+  for (stage = this; stage != NULL; stage = stage->next)
+    if (!stage->process(sample))
+      return false;
+
+  return true;
+}
+
+/**
+* \brief Reset this stage and all the following ones.
+*/
+void ms5805_stage::reset_all(void) {
+  ms5805_stage *stage;
+
+  for (stage = this; stage != NULL; stage = stage->next)
+    stage->reset();
+}
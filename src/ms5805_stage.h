@@ -0,0 +1,94 @@
+#ifndef MS5805_STAGE_H
+#define MS5805_STAGE_H
+
+#include "ms5805_sample.h"
+
+enum ms5805_sample_field {
+  ms5805_sample_field_temperature,
+  ms5805_sample_field_pressure,
+  ms5805_sample_field_adc_temperature,
+  ms5805_sample_field_adc_pressure,
+  ms5805_sample_field_count
+};
+
+// Masks selecting the fields processed by multi-field stages
+#define MS5805_FIELD_TEMPERATURE (1 << ms5805_sample_field_temperature)
+#define MS5805_FIELD_PRESSURE (1 << ms5805_sample_field_pressure)
+#define MS5805_FIELD_ADC_TEMPERATURE (1 << ms5805_sample_field_adc_temperature)
+#define MS5805_FIELD_ADC_PRESSURE (1 << ms5805_sample_field_adc_pressure)
+#define MS5805_FIELD_COMPENSATED                                               \
+  (MS5805_FIELD_TEMPERATURE | MS5805_FIELD_PRESSURE)
+
+/**
+ * \brief Value of a sample field. ADC values are 24-bits and fit.
+ *
+ * \param[in] ms5805_sample* : Sample
+ * \param[in] ms5805_sample_field : Field
+ *
+ * \return int32_t : Value
+ */
+int32_t ms5805_get_field(const struct ms5805_sample *sample,
+                         enum ms5805_sample_field field);
+
+/**
+ * \brief Change a sample field.
+ *
+ * \param[in,out] ms5805_sample* : Sample
+ * \param[in] ms5805_sample_field : Field
+ * \param[in] int32_t : Value
+ */
+void ms5805_set_field(struct ms5805_sample *sample,
+                      enum ms5805_sample_field field, int32_t value);
+
+/**
+ * \brief Processing step applied to samples : filter, decimator, outlier
+ * rejection... Stages are linked with set_next() to form a pipeline.
+ */
+class ms5805_stage {
+
+public:
+  ms5805_stage();
+
+  /**
+   * \brief Process a sample in place.
+   *
+   * \param[in,out] ms5805_sample* : Sample
+   *
+   * \return bool : false if the sample is dropped and must not reach the next
+   * stages
+   */
+  virtual bool process(struct ms5805_sample *sample) = 0;
+
+  /**
+   * \brief Forget the samples seen so far.
+   */
+  virtual void reset(void);
+
+  /**
+   * \brief Set the stage receiving the output of this one.
+   *
+   * \param[in] ms5805_stage* : Next stage, NULL to end the pipeline
+   *
+   * \return ms5805_stage* : Next stage, to chain calls
+   */
+  ms5805_stage *set_next(ms5805_stage *next);
+
+  /**
+   * \brief Process a sample through this stage and all the following ones.
+   *
+   * \param[in,out] ms5805_sample* : Sample
+   *
+   * \return bool : false if a stage dropped the sample
+   */
+  bool run(struct ms5805_sample *sample);
+
+  /**
+   * \brief Reset this stage and all the following ones.
+   */
+  void reset_all(void);
+
+private:
+  ms5805_stage *next;
+};
+
+#endif
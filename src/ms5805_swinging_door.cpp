@@ -0,0 +1,237 @@
+#include "ms5805_swinging_door.h"
+
+/**
+* \brief Quotient of a division rounded towards minus infinity.
+*
+* \param[in] int64_t : Dividend
+* \param[in] uint32_t : Divisor, not 0
+*
+* \return int64_t : Quotient
+*/
+static int64_t ms5805_floor_div(int64_t dividend, uint32_t divisor) {
+  int64_t quotient = dividend / (int64_t)divisor;
+
+  if (quotient * (int64_t)divisor > dividend)
+    quotient--;
+  return quotient;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_sample_field : Field to compress
+* \param[in] int32_t : Largest deviation of the trend, in units of the field
+* \param[in] uint32_t : Longest segment between two corners in us, up to
+* MS5805_SWINGING_DOOR_MAX_SEGMENT_US
+*/
+ms5805_swinging_door::ms5805_swinging_door(enum ms5805_sample_field field,
+                                           int32_t deviation,
+                                           uint32_t max_segment_us)
+    : field(field), deviation(deviation), max_segment(max_segment_us) {
+  if (this->deviation < 0)
+    this->deviation = 0;
+  if (max_segment == 0 || max_segment > MS5805_SWINGING_DOOR_MAX_SEGMENT_US)
+    max_segment = MS5805_SWINGING_DOOR_MAX_SEGMENT_US;
+
+  reset();
+}
+
+/**
+* \brief Narrow the doors with a sample, and pass the previous sample as a
+* corner when they close.
+*
+* \param[in,out] ms5805_sample* : Sample, replaced by a corner
+*
+* \return bool : true if a corner is passed, false if the sample is dropped
+*/
+bool ms5805_swinging_door::process(struct ms5805_sample *sample) {
+  int32_t value = ms5805_get_field(sample, field);
+  uint32_t duration = sample->timestamp - anchor.timestamp;
+  struct ms5805_sample corner;
+  int32_t upper_bound, lower_bound, new_upper, new_lower;
+  uint32_t new_upper_duration, new_lower_duration;
+
+  // The first sample is a corner
+  if (!started) {
+    started = true;
+    open = false;
+    anchor.timestamp = sample->timestamp;
+    anchor.value = value;
+    return true;
+  }
+
+  // A sample at the time of the corner, or from the past, is ignored
+  if (duration == 0 || (int32_t)duration < 0)
+    return false;
+
+  if (!open) {
+    open_doors(sample);
+    return false;
+  }
+
+  // Narrow the slope range with the slopes to both ends of the deviation
+  // around the sample, unless it would become empty, or leave no integer
+  // value for the sample to become a corner
+  upper_bound = value + deviation - anchor.value;
+  lower_bound = value - deviation - anchor.value;
+  if (duration <= max_segment &&
+      (int64_t)lower * duration <= (int64_t)upper_bound * lower_duration &&
+      (int64_t)lower_bound * upper_duration <= (int64_t)upper * duration) {
+    if ((int64_t)upper_bound * upper_duration < (int64_t)upper * duration) {
+      new_upper = upper_bound;
+      new_upper_duration = duration;
+    } else {
+      new_upper = upper;
+      new_upper_duration = upper_duration;
+    }
+    if ((int64_t)lower_bound * lower_duration > (int64_t)lower * duration) {
+      new_lower = lower_bound;
+      new_lower_duration = duration;
+    } else {
+      new_lower = lower;
+      new_lower_duration = lower_duration;
+    }
+    if (ms5805_floor_div((int64_t)new_upper * duration, new_upper_duration) +
+            ms5805_floor_div(-(int64_t)new_lower * duration,
+                             new_lower_duration) >=
+        0) {
+      upper = new_upper;
+      upper_duration = new_upper_duration;
+      lower = new_lower;
+      lower_duration = new_lower_duration;
+      previous = *sample;
+      return false;
+    }
+  }
+
+  // The doors closed : the previous sample is a corner
+  corner = previous;
+  ms5805_set_field(&corner, field, corner_value());
+  anchor.timestamp = corner.timestamp;
+  anchor.value = ms5805_get_field(&corner, field);
+  open_doors(sample);
+  *sample = corner;
+
+  return true;
+}
+
+/**
+* \brief Start again from the next sample.
+*/
+void ms5805_swinging_door::reset(void) {
+  started = false;
+  open = false;
+}
+
+/**
+* \brief Close the current segment, at the end of a log : its last sample
+* becomes a corner.
+*
+* \param[out] ms5805_sample* : Corner
+*
+* \return bool : false if there is no segment to close
+*/
+bool ms5805_swinging_door::flush(struct ms5805_sample *sample) {
+  if (!open)
+    return false;
+
+  *sample = previous;
+  ms5805_set_field(sample, field, corner_value());
+  anchor.timestamp = sample->timestamp;
+  anchor.value = ms5805_get_field(sample, field);
+  open = false;
+
+  return true;
+}
+
+/**
+* \brief Value of the previous sample, moved into the slope range from the
+* anchor.
+*
+* \return int32_t : Corner value
+*/
+int32_t ms5805_swinging_door::corner_value(void) {
+  uint32_t duration = previous.timestamp - anchor.timestamp;
+  int32_t value = ms5805_get_field(&previous, field);
+  int64_t highest, lowest;
+
+  highest = anchor.value +
+            ms5805_floor_div((int64_t)upper * duration, upper_duration);
+  lowest = anchor.value -
+           ms5805_floor_div(-(int64_t)lower * duration, lower_duration);
+
+  if (value > highest)
+    value = (int32_t)highest;
+  if (value < lowest)
+    value = (int32_t)lowest;
+
+  return value;
+}
+
+/**
+* \brief Start a segment from the anchor with its first sample.
+*
+* \param[in] ms5805_sample* : Sample
+*/
+void ms5805_swinging_door::open_doors(const struct ms5805_sample *sample) {
+  int32_t value = ms5805_get_field(sample, field);
+
+  open = true;
+  previous = *sample;
+  upper = value + deviation - anchor.value;
+  lower = value - deviation - anchor.value;
+  upper_duration = sample->timestamp - anchor.timestamp;
+  lower_duration = upper_duration;
+}
+
+/**
+* \brief Class constructor
+*
+* \param[in] ms5805_trend_point* : Corners, in time order
+* \param[in] size_t : Number of corners
+*/
+ms5805_trend_reconstructor::ms5805_trend_reconstructor(
+    const struct ms5805_trend_point *corners, size_t count)
+    : corners(corners), count(count), segment(0) {}
+
+/**
+* \brief Interpolate the trend. Timestamps wrap around like those of the
+* samples : successive calls have to go forward in time, so that logs of any
+* length can be replayed.
+*
+* \param[in] uint32_t : Timestamp in us, not before the previous call
+* \param[out] int32_t* : Value of the trend
+*
+* \return bool : false if the timestamp is outside of the trend
+*/
+bool ms5805_trend_reconstructor::interpolate(uint32_t timestamp,
+                                             int32_t *value) {
+  const struct ms5805_trend_point *start, *end;
+  uint32_t elapsed, duration;
+  int64_t change;
+
+  if (count == 0 || (int32_t)(timestamp - corners[segment].timestamp) < 0)
+    return false;
+
+  while (segment + 1 < count &&
+         (int32_t)(timestamp - corners[segment + 1].timestamp) > 0)
+    segment++;
+
+  start = &corners[segment];
+  elapsed = timestamp - start->timestamp;
+  if (segment + 1 == count) {
+    if (elapsed != 0)
+      return false;
+    *value = start->value;
+    return true;
+  }
+
+  // Rounded to the nearest
+  end = &corners[segment + 1];
+  duration = end->timestamp - start->timestamp;
+  change = ((int64_t)end->value - start->value) * elapsed;
+  *value = start->value +
+           (int32_t)ms5805_floor_div(2 * change + duration, 2 * duration);
+
+  return true;
+}
@@ -0,0 +1,120 @@
+#ifndef MS5805_SWINGING_DOOR_H
+#define MS5805_SWINGING_DOOR_H
+
+#include <stddef.h>
+
+#include "ms5805_stage.h"
+
+// Longest segment between two corner points : sample timestamps wrap around
+// after 2^32 us, about 71 minutes
+#define MS5805_SWINGING_DOOR_MAX_SEGMENT_US 1800000000UL
+
+/**
+ * \brief Point of a piecewise-linear trend : timestamp and value of a field.
+ */
+struct ms5805_trend_point {
+  uint32_t timestamp;
+  int32_t value;
+};
+
+/**
+ * \brief Swinging-door trend compression : keeps only the corner points of a
+ * piecewise-linear approximation of one field, so that the line between two
+ * corners stays within a deviation of every sample in between.
+ *
+ * From the last corner, each sample narrows the range of slopes which pass
+ * within the deviation of all samples so far, the "doors". When a sample
+ * closes them, the previous sample becomes a corner, and its value is moved
+ * onto a slope that was still open, so the bound holds for every sample.
+ * Samples which would leave no integer value for such a corner close the
+ * doors as well. Only the last corner, the slope range and the previous
+ * sample are kept, whatever the length of the segment.
+ *
+ * Corners go down the pipeline with the timestamp and other fields of the
+ * sample they replace, and the others are dropped : a slowly changing
+ * pressure is logged with a few samples per hour. The reconstruction from
+ * the corners, rounded to the nearest, is within the deviation of every
+ * sample.
+ */
+class ms5805_swinging_door : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_sample_field : Field to compress
+   * \param[in] int32_t : Largest deviation of the trend, in units of the
+   * field
+   * \param[in] uint32_t : Longest segment between two corners in us, up to
+   * MS5805_SWINGING_DOOR_MAX_SEGMENT_US
+   */
+  ms5805_swinging_door(
+      enum ms5805_sample_field field, int32_t deviation,
+      uint32_t max_segment_us = MS5805_SWINGING_DOOR_MAX_SEGMENT_US);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Close the current segment, at the end of a log : its last sample
+   * becomes a corner.
+   *
+   * \param[out] ms5805_sample* : Corner
+   *
+   * \return bool : false if there is no segment to close
+   */
+  bool flush(struct ms5805_sample *sample);
+
+private:
+  int32_t corner_value(void);
+  void open_doors(const struct ms5805_sample *sample);
+
+  enum ms5805_sample_field field;
+  int32_t deviation;
+  uint32_t max_segment;
+  bool started;
+  bool open;
+  struct ms5805_trend_point anchor;
+  struct ms5805_sample previous;
+  // Slope range from the anchor, as value differences over durations
+  int32_t upper;
+  uint32_t upper_duration;
+  int32_t lower;
+  uint32_t lower_duration;
+};
+
+/**
+ * \brief Reconstruction of the samples of a trend from its corner points, by
+ * linear interpolation, for instance on the host reading a log.
+ */
+class ms5805_trend_reconstructor {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] ms5805_trend_point* : Corners, in time order
+   * \param[in] size_t : Number of corners
+   */
+  ms5805_trend_reconstructor(const struct ms5805_trend_point *corners,
+                             size_t count);
+
+  /**
+   * \brief Interpolate the trend. Timestamps wrap around like those of the
+   * samples : successive calls have to go forward in time, so that logs of
+   * any length can be replayed.
+   *
+   * \param[in] uint32_t : Timestamp in us, not before the previous call
+   * \param[out] int32_t* : Value of the trend
+   *
+   * \return bool : false if the timestamp is outside of the trend
+   */
+  bool interpolate(uint32_t timestamp, int32_t *value);
+
+private:
+  const struct ms5805_trend_point *corners;
+  size_t count;
+  size_t segment;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "ms5805_vario.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define MS5805_VARIO_NORM_READ(half)                                           \
+  ((int32_t)pgm_read_dword(&ms5805_vario_norms[half]))
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define MS5805_VARIO_NORM_READ(half) (ms5805_vario_norms[half])
+#endif
+
+static_assert(MS5805_VARIO_MAX_WINDOW <= 33,
+              "ms5805_vario_norms covers windows of up to 33 samples");
+
+// Normalizations of the Savitzky-Golay derivative by half window size,
+// evaluated by the compiler
+static const int32_t ms5805_vario_norms[] PROGMEM = {
+    ms5805_vario_norm(0),  ms5805_vario_norm(1),  ms5805_vario_norm(2),
+    ms5805_vario_norm(3),  ms5805_vario_norm(4),  ms5805_vario_norm(5),
+    ms5805_vario_norm(6),  ms5805_vario_norm(7),  ms5805_vario_norm(8),
+    ms5805_vario_norm(9),  ms5805_vario_norm(10), ms5805_vario_norm(11),
+    ms5805_vario_norm(12), ms5805_vario_norm(13), ms5805_vario_norm(14),
+    ms5805_vario_norm(15), ms5805_vario_norm(16)};
+
+// Largest deviation of a sample interval from the mean one, as a fraction of
+// the mean one, for the samples to count as evenly spaced
+#define MS5805_VARIO_JITTER_DIVISOR 16
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint8_t : Window size, odd, 3 to MS5805_VARIO_MAX_WINDOW
+* \param[in] ms5805_altitude_reference* : Altitude reference, NULL for 1013.25
+* mbar
+*/
+ms5805_vario::ms5805_vario(uint8_t window,
+                           const struct ms5805_altitude_reference *reference)
+    : window(window) {
+  if (this->window > MS5805_VARIO_MAX_WINDOW)
+    this->window = MS5805_VARIO_MAX_WINDOW;
+  if (this->window < 3)
+    this->window = 3;
+  // The derivative is taken at a sample of the window
+  if ((this->window & 1) == 0)
+    this->window--;
+
+  set_altitude_reference(reference);
+  reset();
+}
+
+/**
+* \brief Add the altitude of a sample, which is left unchanged.
+*
+* \param[in] ms5805_sample* : Sample
+*
+* \return bool : true, samples are never dropped
+*/
+bool ms5805_vario::process(struct ms5805_sample *sample) {
+  update_altitude(ms5805_altitude_cm(sample->pressure, &reference),
+                  sample->timestamp);
+  return true;
+}
+
+/**
+* \brief Restart from the next measurement.
+*/
+void ms5805_vario::reset(void) {
+  count = 0;
+  oldest = 0;
+  velocity = 0;
+  timestamp = 0;
+}
+
+/**
+* \brief Set the altitude reference. The vertical speed does not depend on it
+* much, but the altitudes of samples do.
+*
+* \param[in] ms5805_altitude_reference* : Reference, copied, NULL for 1013.25
+* mbar
+*/
+void ms5805_vario::set_altitude_reference(
+    const struct ms5805_altitude_reference *reference) {
+  if (reference != NULL)
+    this->reference = *reference;
+  else
+    ms5805_set_altitude_reference(&this->reference, MS5805_STANDARD_PRESSURE);
+}
+
+/**
+* \brief Add an altitude measurement.
+*
+* \param[in] int32_t : Altitude in cm
+* \param[in] uint32_t : Timestamp in us
+*/
+void ms5805_vario::update_altitude(int32_t altitude, uint32_t timestamp) {
+  uint8_t index;
+
+  if (count > 0) {
+    index = (oldest + count - 1) % window;
+    if (timestamp - times[index] > MS5805_VARIO_MAX_GAP_US)
+      reset();
+  }
+
+  if (count < window) {
+    index = (oldest + count) % window;
+    count++;
+  } else {
+    index = oldest;
+    oldest = (oldest + 1) % window;
+  }
+  times[index] = timestamp;
+  altitudes[index] = altitude;
+
+  if (count == window)
+    estimate();
+}
+
+/**
+* \brief Estimated vertical speed in m/s, positive upwards, 0 until the window
+* is full.
+*/
+float ms5805_vario::get_velocity(void) { return velocity; }
+
+/**
+* \brief Time in us the estimated vertical speed holds for, the center of the
+* window.
+*/
+uint32_t ms5805_vario::get_timestamp(void) { return timestamp; }
+
+/**
+* \brief Fit the window and take the slope at its center.
+*/
+void ms5805_vario::estimate(void) {
+  const int32_t half = window / 2;
+  const uint32_t first = times[oldest];
+  const int32_t center = altitudes[(oldest + half) % window];
+  uint32_t span = times[(oldest + window - 1) % window] - first;
+  uint32_t interval, deviation;
+  bool even = true;
+  int32_t i, sum = 0;
+  uint8_t index, next;
+  float mean_time = 0, mean_altitude = 0, covariance = 0, variance = 0;
+  float time;
+
+  if (span == 0)
+    return;
+
+  for (i = 0; i < window - 1 && even; i++) {
+    index = (oldest + i) % window;
+    next = (index + 1) % window;
+    interval = (times[next] - times[index]) * (window - 1);
+    deviation = interval > span ? interval - span : span - interval;
+    even = deviation <= span / MS5805_VARIO_JITTER_DIVISOR;
+  }
+
+  if (even) {
+    // Savitzky-Golay weights i / sum(i^2), applied to altitudes relative to
+    // the center to keep the sum small
+    for (i = -half; i <= half; i++)
+      sum += i * (altitudes[(oldest + half + i) % window] - center);
+
+    // cm per period to m/s
+    velocity = (float)sum * 1e4f * (window - 1) /
+               ((float)MS5805_VARIO_NORM_READ(half) * span);
+    timestamp = first + span / 2;
+    return;
+  }
+
+  // Least-squares slope with the actual timestamps, relative to the first
+  // sample and to the center
+  for (i = 0; i < window; i++) {
+    index = (oldest + i) % window;
+    mean_time += (float)(times[index] - first);
+    mean_altitude += (float)(altitudes[index] - center);
+  }
+  mean_time /= window;
+  mean_altitude /= window;
+  for (i = 0; i < window; i++) {
+    index = (oldest + i) % window;
+    time = (float)(times[index] - first) - mean_time;
+    covariance += time * ((float)(altitudes[index] - center) - mean_altitude);
+    variance += time * time;
+  }
+
+  // cm/us to m/s
+  velocity = covariance / variance * 1e4f;
+  timestamp = first + (uint32_t)(mean_time + 0.5f);
+}
@@ -0,0 +1,106 @@
+#ifndef MS5805_VARIO_H
+#define MS5805_VARIO_H
+
+#include "ms5805_altitude.h"
+#include "ms5805_stage.h"
+
+// Largest window of the vertical speed estimator, up to 33
+#ifndef MS5805_VARIO_MAX_WINDOW
+#define MS5805_VARIO_MAX_WINDOW 33
+#endif
+
+// Longest time between samples, after which the estimator restarts
+#define MS5805_VARIO_MAX_GAP_US 5000000UL
+
+/**
+* \brief Sum of the squared offsets i^2 of a window of 2 * half + 1 samples,
+* i from -half to half : normalization of the Savitzky-Golay derivative.
+*
+* \param[in] int32_t : Half of the window size, rounded down
+*
+* \return int32_t : half * (half + 1) * (2 * half + 1) / 3
+*/
+constexpr int32_t ms5805_vario_norm(int32_t half) {
+  return half * (half + 1) * (2 * half + 1) / 3;
+}
+
+/**
+ * \brief Vertical speed estimator for variometers : Savitzky-Golay
+ * differentiator over a window of altitudes computed from pressure samples.
+ *
+ * The estimate is the slope of the quadratic least-squares fit of the
+ * window, at its center. With evenly spaced samples, it is the sum of the
+ * altitudes weighted by their offset i to the center, divided by the sum of
+ * i^2 and the sample period, in integer arithmetic. When the spacing varies
+ * by more than 1/16 of the period, it is the slope of the linear fit over the
+ * actual timestamps instead, which only differs from the quadratic one by the
+ * asymmetry of the spacing.
+ *
+ * Unlike the difference of two averages, the fit follows ramps without bias.
+ * The noise of the estimate is the altitude noise divided by the period and
+ * by the square root of the sum of i^2. The estimate holds for the center of
+ * the window, (window - 1) / 2 periods ago : smaller windows answer faster,
+ * larger ones are smoother. As a stage, the estimator leaves samples
+ * unchanged.
+ */
+class ms5805_vario : public ms5805_stage {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint8_t : Window size, odd, 3 to MS5805_VARIO_MAX_WINDOW
+   * \param[in] ms5805_altitude_reference* : Altitude reference, NULL for
+   * 1013.25 mbar
+   */
+  ms5805_vario(uint8_t window,
+               const struct ms5805_altitude_reference *reference = NULL);
+
+  bool process(struct ms5805_sample *sample);
+  void reset(void);
+
+  /**
+   * \brief Set the altitude reference. The vertical speed does not depend on
+   * it much, but the altitudes of samples do.
+   *
+   * \param[in] ms5805_altitude_reference* : Reference, copied, NULL for
+   * 1013.25 mbar
+   */
+  void
+  set_altitude_reference(const struct ms5805_altitude_reference *reference);
+
+  /**
+   * \brief Add an altitude measurement.
+   *
+   * \param[in] int32_t : Altitude in cm
+   * \param[in] uint32_t : Timestamp in us
+   */
+  void update_altitude(int32_t altitude, uint32_t timestamp);
+
+  /**
+   * \brief Estimated vertical speed in m/s, positive upwards, 0 until the
+   * window is full.
+   */
+  float get_velocity(void);
+
+  /**
+   * \brief Time in us the estimated vertical speed holds for, the center of
+   * the window.
+   */
+  uint32_t get_timestamp(void);
+
+private:
+  void estimate(void);
+
+  uint8_t window;
+  uint8_t count;
+  uint8_t oldest;
+  struct ms5805_altitude_reference reference;
+  float velocity;
+  uint32_t timestamp;
+  // In arrival order, from the oldest
+  uint32_t times[MS5805_VARIO_MAX_WINDOW];
+  int32_t altitudes[MS5805_VARIO_MAX_WINDOW];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include "ms5805_writer.h"
+
+/**
+* \brief Class constructor
+*
+* \param[in] uint8_t* : Buffer to fill
+* \param[in] size_t : Size of the buffer
+*/
+ms5805_buffer_writer::ms5805_buffer_writer(uint8_t *buffer, size_t size)
+    : buffer(buffer), size(size), used(0) {}
+
+/**
+* \brief Append bytes to the buffer. Nothing is written if they do not all
+* fit, so that the buffer never holds a partial record.
+*
+* \param[in] uint8_t* : Bytes to write
+* \param[in] size_t : Number of bytes
+*
+* \return size_t : Number of bytes actually written
+*/
+size_t ms5805_buffer_writer::write(const uint8_t *data, size_t length) {
+  if (length > size - used)
+    return 0;
+
+  memcpy(buffer + used, data, length);
+  used += length;
+
+  return length;
+}
+
+/**
+* \brief Number of bytes stored in the buffer.
+*/
+size_t ms5805_buffer_writer::length(void) { return used; }
+
+/**
+* \brief Discard the content of the buffer.
+*/
+void ms5805_buffer_writer::clear(void) { used = 0; }
+
+#if defined(ARDUINO)
+/**
+* \brief Class constructor
+*
+* \param[in] Print& : Stream to write to
+*/
+ms5805_print_writer::ms5805_print_writer(Print &print) : print(print) {}
+
+/**
+* \brief Write bytes to the stream.
+*
+* \param[in] uint8_t* : Bytes to write
+* \param[in] size_t : Number of bytes
+*
+* \return size_t : Number of bytes actually written
+*/
+size_t ms5805_print_writer::write(const uint8_t *data, size_t length) {
+  return print.write(data, length);
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef MS5805_WRITER_H
+#define MS5805_WRITER_H
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#elif defined(ARDUINO)
+#include "WProgram.h"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Byte sink used by the logging encoders.
+ */
+class ms5805_writer {
+
+public:
+  /**
+   * \brief Write bytes to the sink.
+   *
+   * \param[in] uint8_t* : Bytes to write
+   * \param[in] size_t : Number of bytes
+   *
+   * \return size_t : Number of bytes actually written
+   */
+  virtual size_t write(const uint8_t *data, size_t length) = 0;
+};
+
+/**
+ * \brief Writer filling a caller-supplied buffer.
+ */
+class ms5805_buffer_writer : public ms5805_writer {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] uint8_t* : Buffer to fill
+   * \param[in] size_t : Size of the buffer
+   */
+  ms5805_buffer_writer(uint8_t *buffer, size_t size);
+
+  size_t write(const uint8_t *data, size_t length);
+
+  /**
+   * \brief Number of bytes stored in the buffer.
+   */
+  size_t length(void);
+
+  /**
+   * \brief Discard the content of the buffer.
+   */
+  void clear(void);
+
+private:
+  uint8_t *buffer;
+  size_t size;
+  size_t used;
+};
+
+#if defined(ARDUINO)
+/**
+ * \brief Writer forwarding to an Arduino stream (Serial, SD file, ...).
+ */
+class ms5805_print_writer : public ms5805_writer {
+
+public:
+  /**
+   * \brief Class constructor
+   *
+   * \param[in] Print& : Stream to write to
+   */
+  ms5805_print_writer(Print &print);
+
+  size_t write(const uint8_t *data, size_t length);
+
+private:
+  Print &print;
+};
+#endif
+
+#endif